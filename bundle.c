@@ -0,0 +1,216 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bundle.h"
+#include "pkg.h"
+
+#include <errno.h>
+#include <string.h>
+
+/* A bundle concatenates the .pc files of many packages, each introduced
+ * by a header line:
+ *
+ *   [<key>] <pcfiledir>
+ *   <contents of key.pc>
+ *   [<key>] ...
+ *
+ * The optional pcfiledir is relative to the directory holding the
+ * bundle and defaults to that directory. Lines before the first header
+ * are ignored. The file is mapped once and the entries point into it.
+ */
+struct Bundle_
+{
+  GMappedFile *file;
+  GHashTable *entries; /* key -> BundleEntry */
+  GList *order;
+};
+
+/* Parse the header line running from LINE to END. Returns FALSE if it
+ * does not name a package.
+ */
+static gboolean
+parse_header (const char *dirname, const char *line, const char *end,
+              char **key, char **path)
+{
+  const char *p = line + 1;
+  const char *close;
+  char *pcfiledir;
+  char *filename;
+
+  close = memchr (p, ']', end - p);
+  if (close == NULL || close == p)
+    return FALSE;
+
+  *key = g_strndup (p, close - p);
+  if (strpbrk (*key, " \t/") != NULL)
+    {
+      g_free (*key);
+      return FALSE;
+    }
+
+  p = close + 1;
+  while (p < end && g_ascii_isspace (*p))
+    p++;
+  while (end > p && g_ascii_isspace (end[-1]))
+    end--;
+
+  if (p == end)
+    pcfiledir = g_strdup (dirname);
+  else
+    {
+      pcfiledir = g_strndup (p, end - p);
+      if (!g_path_is_absolute (pcfiledir))
+        {
+          char *tmp = pcfiledir;
+
+          pcfiledir = g_build_filename (dirname, tmp, NULL);
+          g_free (tmp);
+        }
+    }
+
+  filename = g_strconcat (*key, ".pc", NULL);
+  *path = g_build_filename (pcfiledir, filename, NULL);
+  g_free (filename);
+  g_free (pcfiledir);
+
+  return TRUE;
+}
+
+static void
+bundle_entry_free (gpointer data)
+{
+  BundleEntry *entry = data;
+
+  g_free (entry->key);
+  g_free (entry->path);
+  g_free (entry);
+}
+
+Bundle *
+bundle_load (const char *dirname)
+{
+  Bundle *bundle;
+  BundleEntry *entry = NULL;
+  GMappedFile *file;
+  GError *error = NULL;
+  const char *data;
+  const char *end;
+  const char *p;
+  char *filename;
+
+  filename = g_build_filename (dirname, BUNDLE_FILENAME, NULL);
+  file = g_mapped_file_new (filename, FALSE, &error);
+  if (file == NULL)
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        debug_spew ("Cannot map bundle '%s': %s\n", filename,
+                    error->message);
+      g_error_free (error);
+      g_free (filename);
+      return NULL;
+    }
+
+  debug_spew ("Indexing bundle '%s'\n", filename);
+
+  bundle = g_new0 (Bundle, 1);
+  bundle->file = file;
+  bundle->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           NULL, bundle_entry_free);
+
+  data = g_mapped_file_get_contents (file);
+  end = data + g_mapped_file_get_length (file);
+
+  for (p = data; p != NULL && p < end; )
+    {
+      const char *eol = memchr (p, '\n', end - p);
+      const char *next = eol ? eol + 1 : end;
+      char *key;
+      char *path;
+
+      if (*p != '[')
+        {
+          p = next;
+          continue;
+        }
+
+      if (entry != NULL)
+        entry->length = p - entry->data;
+      entry = NULL;
+
+      if (!parse_header (dirname, p, eol ? eol : end, &key, &path))
+        {
+          verbose_error ("Invalid package header '%.*s' in bundle '%s'\n",
+                         (int) ((eol ? eol : end) - p), p, filename);
+          p = next;
+          continue;
+        }
+
+      if (g_hash_table_lookup (bundle->entries, key) != NULL)
+        {
+          debug_spew ("Ignoring package '%s' defined twice in bundle '%s'\n",
+                      key, filename);
+          g_free (key);
+          g_free (path);
+          p = next;
+          continue;
+        }
+
+      entry = g_new0 (BundleEntry, 1);
+      entry->key = key;
+      entry->path = path;
+      entry->data = next;
+      g_hash_table_insert (bundle->entries, entry->key, entry);
+      bundle->order = g_list_prepend (bundle->order, entry);
+
+      p = next;
+    }
+
+  if (entry != NULL)
+    entry->length = end - entry->data;
+
+  bundle->order = g_list_reverse (bundle->order);
+  debug_spew ("Bundle '%s' holds %u packages\n", filename,
+              g_hash_table_size (bundle->entries));
+  g_free (filename);
+
+  return bundle;
+}
+
+const BundleEntry *
+bundle_lookup (Bundle *bundle, const char *name)
+{
+  return g_hash_table_lookup (bundle->entries, name);
+}
+
+GList *
+bundle_get_entries (Bundle *bundle)
+{
+  return bundle->order;
+}
+
+void
+bundle_free (Bundle *bundle)
+{
+  g_list_free (bundle->order);
+  g_hash_table_destroy (bundle->entries);
+  g_mapped_file_unref (bundle->file);
+  g_free (bundle);
+}
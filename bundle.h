@@ -0,0 +1,55 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef PKG_CONFIG_BUNDLE_H
+#define PKG_CONFIG_BUNDLE_H
+
+#include <glib.h>
+
+/* Name of the bundle file looked for in each search directory */
+#define BUNDLE_FILENAME "pkgconfig.bundle"
+
+typedef struct Bundle_ Bundle;
+
+/* A package definition found in a bundle. PATH is the location of the
+ * .pc file it stands in for, which sets its pcfiledir.
+ */
+typedef struct
+{
+  char *key;
+  char *path;
+  const char *data;
+  gsize length;
+} BundleEntry;
+
+/* Map the bundle file of DIRNAME and index the packages it holds.
+ * Returns NULL if the directory has no bundle.
+ */
+Bundle *           bundle_load         (const char *dirname);
+
+/* Returns the entry for the package NAME, or NULL if the bundle does
+ * not define it.
+ */
+const BundleEntry *bundle_lookup       (Bundle     *bundle,
+                                        const char *name);
+
+/* All entries of the bundle, in the order they appear in the file. */
+GList *            bundle_get_entries  (Bundle     *bundle);
+
+void               bundle_free         (Bundle     *bundle);
+
+#endif
@@ -0,0 +1,876 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cache.h"
+#include "pkg.h"
+
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+gboolean disable_cache = TRUE;
+char *cache_dir = NULL;
+
+/* A directory index is a text file:
+ *
+ *   pkg-config dir index 2
+ *   <mtime> <dev> <ino>
+ *   <directory>
+ *   <exact>
+ *   <name>
+ *   ...
+ *
+ * listing every *.pc entry of the directory with the extension
+ * stripped. Entries are not stat()ed while building it, so a name in
+ * the index only means the file may exist. <exact> is 1 if a name that
+ * is not listed cannot exist either, see dir_names_exact(), else 0.
+ */
+#define INDEX_MAGIC "pkg-config dir index 2\n"
+#define INDEX_SUFFIX ".dirindex"
+
+#define EXT_LEN 3
+
+struct DirIndex_
+{
+  GHashTable *names;
+  gboolean exact; /* whether a name not in NAMES surely does not exist */
+};
+
+char *
+cache_file_path (const char *key, const char *suffix)
+{
+  char *sum;
+  char *base;
+  char *path;
+
+  sum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  base = g_strconcat (sum, suffix, NULL);
+  path = g_build_filename (cache_dir, base, NULL);
+  g_free (base);
+  g_free (sum);
+
+  return path;
+}
+
+static void
+index_add_name (DirIndex *index, const char *name, gsize len)
+{
+  char *key;
+
+#ifdef G_OS_WIN32
+  /* Guard against .pc file being installed with UPPER CASE name */
+  key = g_ascii_strdown (name, len);
+#else
+  key = g_strndup (name, len);
+#endif
+
+  g_hash_table_insert (index->names, key, key);
+}
+
+static char *
+format_header (const char *dirname, const GStatBuf *st)
+{
+  return g_strdup_printf (INDEX_MAGIC "%" G_GUINT64_FORMAT
+                          " %" G_GUINT64_FORMAT
+                          " %" G_GUINT64_FORMAT "\n%s\n",
+                          (guint64) st->st_mtime, (guint64) st->st_dev,
+                          (guint64) st->st_ino, dirname);
+}
+
+/* Read a saved index, returning NULL unless it was written for this
+ * very directory in its current state.
+ */
+static DirIndex *
+read_index (const char *index_path, const char *header)
+{
+  DirIndex *index;
+  char *contents;
+  gsize length;
+  gsize header_len;
+  const char *p;
+  const char *end;
+
+  if (!g_file_get_contents (index_path, &contents, &length, NULL))
+    return NULL;
+
+  header_len = strlen (header);
+  if (length < header_len || memcmp (contents, header, header_len) != 0)
+    {
+      g_free (contents);
+      return NULL;
+    }
+
+  p = contents + header_len;
+  end = contents + length;
+  if (end - p < 2 || (p[0] != '0' && p[0] != '1') || p[1] != '\n')
+    {
+      g_free (contents);
+      return NULL;
+    }
+
+  index = g_new0 (DirIndex, 1);
+  index->names = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, NULL);
+  index->exact = p[0] == '1';
+
+  p += 2;
+  while (p < end)
+    {
+      const char *eol = memchr (p, '\n', end - p);
+
+      if (eol == NULL)
+        eol = end;
+      if (eol > p)
+        index_add_name (index, p, eol - p);
+      p = eol + 1;
+    }
+
+  g_free (contents);
+
+  return index;
+}
+
+static gboolean
+has_letter (const char *name, gsize len)
+{
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    if (g_ascii_isalpha (name[i]))
+      return TRUE;
+
+  return FALSE;
+}
+
+gboolean
+dir_names_exact (const char *dirname, const char *sample)
+{
+#ifdef G_OS_WIN32
+  /* Names are folded to lower case before they are compared */
+  return TRUE;
+#else
+  char *swapped;
+  char *path;
+  char *p;
+  GStatBuf st;
+  gboolean exact;
+
+#ifdef _PC_CASE_SENSITIVE
+  {
+    long case_sensitive = pathconf (dirname, _PC_CASE_SENSITIVE);
+
+    if (case_sensitive >= 0)
+      return case_sensitive != 0;
+  }
+#endif
+
+  if (sample == NULL || !has_letter (sample, strlen (sample)))
+    return FALSE;
+
+  /* A case-insensitive filesystem finds the name in another case too */
+  swapped = g_strdup (sample);
+  for (p = swapped; *p != '\0'; p++)
+    {
+      if (*p >= 'a' && *p <= 'z')
+        *p = g_ascii_toupper (*p);
+      else
+        *p = g_ascii_tolower (*p);
+    }
+
+  path = g_strdup_printf ("%s%c%s.pc", dirname, G_DIR_SEPARATOR, swapped);
+  exact = g_stat (path, &st) != 0 && errno == ENOENT;
+  g_free (path);
+  g_free (swapped);
+
+  return exact;
+#endif
+}
+
+/* List the directory, returning the names of all *.pc entries in a new
+ * index, or NULL if it cannot be read. If LISTING is not NULL the names
+ * are appended to it, and it is freed and set to NULL if they cannot be
+ * written down one per line.
+ */
+static DirIndex *
+build_index (const char *dirname, GString **listing)
+{
+  DirIndex *index;
+  GDir *dir;
+  const gchar *filename;
+  char *dirname_copy;
+  int dirnamelen;
+  char *sample = NULL;
+
+  /* Win32 opendir doesn't like superfluous trailing (back)slashes */
+  dirname_copy = g_strdup (dirname);
+  dirnamelen = strlen (dirname_copy);
+  if (dirnamelen > 1 && G_IS_DIR_SEPARATOR (dirname_copy[dirnamelen-1]))
+    dirname_copy[dirnamelen-1] = '\0';
+
+  dir = g_dir_open (dirname_copy, 0, NULL);
+  g_free (dirname_copy);
+
+  if (!dir)
+    {
+      /* The directory may still be searchable without being readable */
+      debug_spew ("Cannot open directory '%s' in package search path: %s\n",
+                  dirname, g_strerror (errno));
+      return NULL;
+    }
+
+  index = g_new0 (DirIndex, 1);
+  index->names = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, NULL);
+
+  while ((filename = g_dir_read_name (dir)))
+    {
+      gsize len = strlen (filename);
+
+      if (len <= EXT_LEN ||
+#ifdef G_OS_WIN32
+          g_ascii_strcasecmp (filename + len - EXT_LEN, ".pc") != 0
+#else
+          strcmp (filename + len - EXT_LEN, ".pc") != 0
+#endif
+          )
+        continue;
+
+      index_add_name (index, filename, len - EXT_LEN);
+
+      if (sample == NULL && has_letter (filename, len - EXT_LEN))
+        sample = g_strndup (filename, len - EXT_LEN);
+
+      if (*listing == NULL)
+        continue;
+      if (memchr (filename, '\n', len) != NULL)
+        {
+          g_string_free (*listing, TRUE);
+          *listing = NULL;
+          continue;
+        }
+      g_string_append_len (*listing, filename, len - EXT_LEN);
+      g_string_append_c (*listing, '\n');
+    }
+  g_dir_close (dir);
+
+  index->exact = dir_names_exact (dirname, sample);
+  g_free (sample);
+
+  return index;
+}
+
+static void
+write_cache_file (const char *path, GString *data)
+{
+  GError *error = NULL;
+  char *dir = g_path_get_dirname (path);
+
+  if (g_mkdir_with_parents (dir, 0755) != 0)
+    {
+      debug_spew ("Cannot create cache directory '%s': %s\n",
+                  dir, g_strerror (errno));
+      g_free (dir);
+      return;
+    }
+  g_free (dir);
+
+  if (!g_file_set_contents (path, data->str, data->len, &error))
+    {
+      debug_spew ("Cannot write cache file '%s': %s\n",
+                  path, error->message);
+      g_error_free (error);
+    }
+}
+
+DirIndex *
+dir_index_load (const char *dirname)
+{
+  DirIndex *index;
+  GStatBuf st;
+  char *index_path;
+  char *header;
+  GString *listing;
+
+  if (g_stat (dirname, &st) != 0)
+    {
+      int saved_errno = errno;
+
+      debug_spew ("Cannot stat directory '%s' in package search path: %s\n",
+                  dirname, g_strerror (saved_errno));
+      if (saved_errno != ENOENT && saved_errno != ENOTDIR)
+        return NULL;
+
+      /* Nothing can be found in a directory that does not exist */
+      index = g_new0 (DirIndex, 1);
+      index->names = g_hash_table_new (g_str_hash, g_str_equal);
+      index->exact = TRUE;
+      return index;
+    }
+
+  if (disable_cache)
+    {
+      /* The index only lasts for this run */
+      debug_spew ("Indexing directory '%s'\n", dirname);
+      listing = NULL;
+      return build_index (dirname, &listing);
+    }
+
+  index_path = cache_file_path (dirname, INDEX_SUFFIX);
+  header = format_header (dirname, &st);
+
+  index = read_index (index_path, header);
+  if (index != NULL)
+    {
+      debug_spew ("Using index '%s' for directory '%s'\n",
+                  index_path, dirname);
+      g_free (header);
+      g_free (index_path);
+      return index;
+    }
+
+  debug_spew ("Indexing directory '%s'\n", dirname);
+
+  /* The index is located by a hash of the directory name and the name
+   * is checked when reading it back, so it cannot contain a newline.
+   * The index of a racy directory is only kept in memory.
+   */
+  if (strchr (dirname, '\n') == NULL &&
+      time (NULL) - st.st_mtime >= RACY_MTIME_SECONDS)
+    listing = g_string_new (NULL);
+  else
+    listing = NULL;
+
+  index = build_index (dirname, &listing);
+
+  if (index != NULL && listing != NULL)
+    {
+      g_string_prepend (listing, index->exact ? "1\n" : "0\n");
+      g_string_prepend (listing, header);
+      write_cache_file (index_path, listing);
+    }
+  if (listing != NULL)
+    g_string_free (listing, TRUE);
+
+  g_free (header);
+  g_free (index_path);
+
+  return index;
+}
+
+void
+dir_index_add_names (DirIndex *index, GHashTable *names)
+{
+  GHashTableIter iter;
+  gpointer name;
+
+  g_hash_table_iter_init (&iter, index->names);
+  while (g_hash_table_iter_next (&iter, &name, NULL))
+    g_hash_table_add (names, g_strdup (name));
+}
+
+void
+dir_index_free (DirIndex *index)
+{
+  g_hash_table_destroy (index->names);
+  g_free (index);
+}
+
+gboolean
+dir_index_may_contain (DirIndex *index, const char *name)
+{
+  gboolean found;
+
+  /* Names with a directory part refer below the indexed directory */
+  if (strchr (name, '/') != NULL || strchr (name, G_DIR_SEPARATOR) != NULL)
+    return TRUE;
+
+#ifdef G_OS_WIN32
+  {
+    char *folded = g_ascii_strdown (name, -1);
+    found = g_hash_table_lookup (index->names, folded) != NULL;
+    g_free (folded);
+  }
+#else
+  found = g_hash_table_lookup (index->names, name) != NULL;
+#endif
+
+  return found || !index->exact;
+}
+
+gboolean
+dir_index_is_exact (DirIndex *index)
+{
+  return index->exact;
+}
+
+/* A compiled package is a binary file, only meant to be read back by
+ * the same pkg-config binary on the same machine:
+ *
+ *   header     string, see package_cache_header()
+ *   lookups    count, then name and outside value (or none) of every
+ *              variable looked up while parsing
+ *   fields     name, version, description, url, orig_prefix
+ *   vars       count, then name, value and whether the value is still
+ *              unexpanded
+ *   modules    requires, requires.private and conflicts as a count,
+ *              then name, comparison and version of each entry
+ *   flags      libs and cflags as a count, then type, arg and join of
+ *              each flag, with the Libs.private field in between as
+ *              written
+ *   counts     libs_num, libs_private_num, libs_private_first
+ *
+ * Integers are native 32-bit words and strings are a length followed
+ * by the bytes, with a length of NO_STRING standing for NULL.
+ */
+#define PACKAGE_MAGIC "pkg-config package 5\n"
+#define PACKAGE_SUFFIX ".package"
+
+#define NO_STRING G_MAXUINT32
+
+typedef struct
+{
+  const char *p;
+  const char *end;
+  gboolean failed;
+} CacheReader;
+
+/* Everything the parse result depends on besides the file contents and
+ * the variables it looks up.
+ */
+static char *
+package_cache_id (const char *key, const char *path, FieldMask fields)
+{
+  gboolean msvc = FALSE;
+
+#ifdef G_OS_WIN32
+  msvc = msvc_syntax;
+#endif
+
+  return g_strdup_printf (PACKAGE_MAGIC "%s\n%s\n%u %d%d %s\n",
+                          path, key, (guint) fields,
+                          define_prefix != FALSE, msvc,
+                          prefix_variable ? prefix_variable : "");
+}
+
+static char *
+package_cache_header (const char *id, const GStatBuf *st)
+{
+  return g_strdup_printf ("%s%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT
+                          " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT
+                          " %" G_GUINT64_FORMAT "\n",
+                          id, (guint64) st->st_size, (guint64) st->st_mtime,
+                          (guint64) st->st_ctime, (guint64) st->st_dev,
+                          (guint64) st->st_ino);
+}
+
+static void
+append_u32 (GString *out, guint32 value)
+{
+  g_string_append_len (out, (const char *) &value, sizeof (value));
+}
+
+static void
+append_string (GString *out, const char *str)
+{
+  if (str == NULL)
+    {
+      append_u32 (out, NO_STRING);
+      return;
+    }
+
+  append_u32 (out, strlen (str));
+  g_string_append (out, str);
+}
+
+static void
+append_module_list (GString *out, GList *list)
+{
+  GList *iter;
+
+  append_u32 (out, g_list_length (list));
+  for (iter = list; iter != NULL; iter = g_list_next (iter))
+    {
+      RequiredVersion *ver = iter->data;
+
+      append_string (out, ver->name);
+      append_u32 (out, ver->comparison);
+      append_string (out, ver->version);
+    }
+}
+
+static void
+append_flag_list (GString *out, GList *list)
+{
+  GList *iter;
+
+  append_u32 (out, g_list_length (list));
+  for (iter = list; iter != NULL; iter = g_list_next (iter))
+    {
+      Flag *flag = iter->data;
+
+      append_u32 (out, flag->type);
+      append_string (out, flag->arg);
+      append_u32 (out, flag->join);
+    }
+}
+
+static void
+append_vars (GString *out, Package *pkg)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+
+  append_u32 (out, g_hash_table_size (pkg->vars) - 1);
+  g_hash_table_iter_init (&iter, pkg->vars);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      /* pcfiledir is set up again from the path */
+      if (strcmp (key, "pcfiledir") == 0)
+        continue;
+
+      append_string (out, key);
+      append_string (out, value);
+      append_u32 (out, pkg->unexpanded_vars != NULL &&
+                  g_hash_table_lookup (pkg->unexpanded_vars, key) != NULL);
+    }
+}
+
+static guint32
+read_u32 (CacheReader *reader)
+{
+  guint32 value;
+
+  if (reader->failed || reader->end - reader->p < (gssize) sizeof (value))
+    {
+      reader->failed = TRUE;
+      return 0;
+    }
+
+  memcpy (&value, reader->p, sizeof (value));
+  reader->p += sizeof (value);
+
+  return value;
+}
+
+/* Returns the bytes of the next string without copying them, setting
+ * *LEN to NO_STRING for a NULL string.
+ */
+static const char *
+read_span (CacheReader *reader, guint32 *len)
+{
+  const char *start;
+
+  *len = read_u32 (reader);
+  if (reader->failed || *len == NO_STRING)
+    return NULL;
+
+  if ((gsize) (reader->end - reader->p) < *len)
+    {
+      reader->failed = TRUE;
+      *len = NO_STRING;
+      return NULL;
+    }
+
+  start = reader->p;
+  reader->p += *len;
+
+  return start;
+}
+
+static char *
+read_string (CacheReader *reader)
+{
+  guint32 len;
+  const char *start = read_span (reader, &len);
+
+  if (start == NULL)
+    return NULL;
+
+  return g_strndup (start, len);
+}
+
+static gboolean
+read_string_equal (CacheReader *reader, const char *str)
+{
+  guint32 len;
+  const char *start = read_span (reader, &len);
+
+  if (reader->failed)
+    return FALSE;
+  if (start == NULL || str == NULL)
+    return start == NULL && str == NULL;
+
+  return len == strlen (str) && memcmp (start, str, len) == 0;
+}
+
+static GList *
+read_module_list (CacheReader *reader, Package *pkg)
+{
+  GList *list = NULL;
+  guint32 n;
+
+  for (n = read_u32 (reader); n > 0 && !reader->failed; n--)
+    {
+      RequiredVersion *ver = g_new0 (RequiredVersion, 1);
+
+      ver->owner = pkg;
+      ver->name = read_string (reader);
+      ver->comparison = read_u32 (reader);
+      ver->version = read_string (reader);
+      list = g_list_prepend (list, ver);
+    }
+
+  return g_list_reverse (list);
+}
+
+static GList *
+read_flag_list (CacheReader *reader)
+{
+  GList *list = NULL;
+  guint32 n;
+
+  for (n = read_u32 (reader); n > 0 && !reader->failed; n--)
+    {
+      FlagType type = read_u32 (reader);
+      guint32 len;
+      const char *arg = read_span (reader, &len);
+      Flag *flag;
+
+      if (arg == NULL)
+        {
+          reader->failed = TRUE;
+          break;
+        }
+
+      flag = flag_new (type, arg, len);
+      flag->join = read_u32 (reader);
+      if (flag->join != 0 && flag->join >= len)
+        reader->failed = TRUE;
+      list = g_list_prepend (list, flag);
+    }
+
+  return g_list_reverse (list);
+}
+
+Package *
+package_cache_load (const char *key, const char *path, const GStatBuf *st,
+                    FieldMask fields)
+{
+  Package *pkg;
+  CacheReader reader;
+  char *id;
+  char *header;
+  char *entry_path;
+  char *contents;
+  gsize length;
+  guint32 n;
+
+  if (disable_cache)
+    return NULL;
+
+  id = package_cache_id (key, path, fields);
+  entry_path = cache_file_path (id, PACKAGE_SUFFIX);
+  header = package_cache_header (id, st);
+  g_free (id);
+
+  if (!g_file_get_contents (entry_path, &contents, &length, NULL))
+    {
+      g_free (header);
+      g_free (entry_path);
+      return NULL;
+    }
+
+  reader.p = contents;
+  reader.end = contents + length;
+  reader.failed = FALSE;
+
+  if (!read_string_equal (&reader, header))
+    {
+      debug_spew ("Cached package '%s' is out of date\n", entry_path);
+      g_free (contents);
+      g_free (header);
+      g_free (entry_path);
+      return NULL;
+    }
+  g_free (header);
+
+  pkg = g_new0 (Package, 1);
+  pkg->key = g_strdup (key);
+
+  /* Variables coming from the command line or the environment were
+   * substituted into the cached fields, so they have to be unchanged.
+   */
+  for (n = read_u32 (&reader); n > 0 && !reader.failed; n--)
+    {
+      guint32 len;
+      const char *start = read_span (&reader, &len);
+      char *var;
+      char *value;
+
+      if (start == NULL)
+        {
+          reader.failed = TRUE;
+          break;
+        }
+
+      var = g_strndup (start, len);
+      value = package_get_external_var (pkg, var);
+      g_free (var);
+      if (!read_string_equal (&reader, value))
+        {
+          debug_spew ("Cached package '%s' used variables that changed\n",
+                      entry_path);
+          reader.failed = TRUE;
+        }
+      g_free (value);
+    }
+
+  pkg->path = g_strdup (path);
+  pkg->pcfiledir = g_path_get_dirname (path);
+  pkg->vars = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_insert (pkg->vars, "pcfiledir", pkg->pcfiledir);
+
+  pkg->name = read_string (&reader);
+  pkg->version = read_string (&reader);
+  pkg->description = read_string (&reader);
+  pkg->url = read_string (&reader);
+  pkg->orig_prefix = read_string (&reader);
+
+  for (n = read_u32 (&reader); n > 0 && !reader.failed; n--)
+    {
+      char *var = read_string (&reader);
+      char *value = read_string (&reader);
+
+      if (var == NULL || value == NULL)
+        {
+          g_free (var);
+          g_free (value);
+          reader.failed = TRUE;
+          break;
+        }
+      g_hash_table_insert (pkg->vars, var, value);
+
+      if (read_u32 (&reader))
+        {
+          if (pkg->unexpanded_vars == NULL)
+            pkg->unexpanded_vars = g_hash_table_new (g_str_hash, g_str_equal);
+          g_hash_table_insert (pkg->unexpanded_vars, var, var);
+        }
+    }
+
+  pkg->requires_entries = read_module_list (&reader, pkg);
+  pkg->requires_private_entries = read_module_list (&reader, pkg);
+  pkg->conflicts = read_module_list (&reader, pkg);
+  pkg->libs = read_flag_list (&reader);
+  pkg->libs_private_field = read_string (&reader);
+  pkg->cflags = read_flag_list (&reader);
+  pkg->libs_num = read_u32 (&reader);
+  pkg->libs_private_num = read_u32 (&reader);
+  pkg->libs_private_first = read_u32 (&reader);
+
+  if (reader.p != reader.end)
+    reader.failed = TRUE;
+
+  g_free (contents);
+
+  if (reader.failed)
+    {
+      package_free (pkg);
+      g_free (entry_path);
+      return NULL;
+    }
+
+  debug_spew ("Loaded package file '%s' from cache '%s'\n",
+              path, entry_path);
+  g_free (entry_path);
+
+  return pkg;
+}
+
+void
+package_cache_save (Package *pkg, const char *path, const GStatBuf *st,
+                    FieldMask fields, GHashTable *lookups)
+{
+  GString *out;
+  GHashTableIter iter;
+  gpointer var;
+  char *id;
+  char *header;
+  char *entry_path;
+
+  if (disable_cache)
+    return;
+
+  /* As for directories, a file changed this recently could change again
+   * without the recorded size and times noticing.
+   */
+  if (time (NULL) - st->st_mtime < RACY_MTIME_SECONDS)
+    return;
+
+  id = package_cache_id (pkg->key, path, fields);
+  entry_path = cache_file_path (id, PACKAGE_SUFFIX);
+  header = package_cache_header (id, st);
+  g_free (id);
+
+  out = g_string_new (NULL);
+  append_string (out, header);
+  g_free (header);
+
+  append_u32 (out, g_hash_table_size (lookups));
+  g_hash_table_iter_init (&iter, lookups);
+  while (g_hash_table_iter_next (&iter, &var, NULL))
+    {
+      char *value = package_get_external_var (pkg, var);
+
+      append_string (out, var);
+      append_string (out, value);
+      g_free (value);
+    }
+
+  append_string (out, pkg->name);
+  append_string (out, pkg->version);
+  append_string (out, pkg->description);
+  append_string (out, pkg->url);
+  append_string (out, pkg->orig_prefix);
+
+  append_vars (out, pkg);
+
+  append_module_list (out, pkg->requires_entries);
+  append_module_list (out, pkg->requires_private_entries);
+  append_module_list (out, pkg->conflicts);
+  append_flag_list (out, pkg->libs);
+  append_string (out, pkg->libs_private_field);
+  append_flag_list (out, pkg->cflags);
+  append_u32 (out, pkg->libs_num);
+  append_u32 (out, pkg->libs_private_num);
+  append_u32 (out, pkg->libs_private_first);
+
+  debug_spew ("Saving package file '%s' to cache '%s'\n", path, entry_path);
+  write_cache_file (entry_path, out);
+
+  g_string_free (out, TRUE);
+  g_free (entry_path);
+}
@@ -0,0 +1,98 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef PKG_CONFIG_CACHE_H
+#define PKG_CONFIG_CACHE_H
+
+#include "pkg.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+typedef struct DirIndex_ DirIndex;
+
+/* Load the index of package names available in DIRNAME, rebuilding and
+ * saving it when it is missing or older than the directory, unless
+ * caching is disabled. Returns NULL if the directory cannot be listed,
+ * in which case the caller has to probe it itself.
+ */
+DirIndex *dir_index_load         (const char *dirname);
+
+/* Add the names in INDEX to the set NAMES, which frees its keys. */
+void      dir_index_add_names    (DirIndex   *index,
+                                  GHashTable *names);
+
+void      dir_index_free         (DirIndex   *index);
+
+/* Whether a package that is not among the .pc files listed in DIRNAME
+ * cannot be opened there under another case either. Names are folded on
+ * Windows. Elsewhere the filesystem is asked, or SAMPLE, the name of a
+ * package in the directory, is looked up with its case swapped. FALSE
+ * if it cannot be told.
+ */
+gboolean  dir_names_exact        (const char *dirname,
+                                  const char *sample);
+
+/* Returns FALSE only if NAME.pc is known not to exist in the indexed
+ * directory. A TRUE result still has to be confirmed by the caller.
+ */
+gboolean  dir_index_may_contain  (DirIndex   *index,
+                                  const char *name);
+
+/* Whether a name not listed in the index surely has no .pc file in the
+ * directory, see dir_names_exact().
+ */
+gboolean  dir_index_is_exact     (DirIndex   *index);
+
+/* Returns the package parsed earlier from the file at PATH, whose
+ * current status is ST, with the same FIELDS, or NULL if there is no such cache entry or it
+ * is out of date.
+ */
+Package * package_cache_load     (const char     *key,
+                                  const char     *path,
+                                  const GStatBuf *st,
+                                  FieldMask       fields);
+
+/* Save the package just parsed from the file at PATH. LOOKUPS holds
+ * the names of all variables looked up while parsing it.
+ */
+void      package_cache_save     (Package        *pkg,
+                                  const char     *path,
+                                  const GStatBuf *st,
+                                  FieldMask       fields,
+                                  GHashTable     *lookups);
+
+/* Path of the file holding the cache entry identified by KEY. */
+char *    cache_file_path        (const char *key,
+                                  const char *suffix);
+
+/* A directory changed less than this many seconds ago can change again
+ * without its mtime moving, so an index of it could go stale unnoticed.
+ * The same goes for files. Only the mtime is held to this: a change that
+ * puts back an older mtime still moves the ctime, which is compared.
+ */
+#define RACY_MTIME_SECONDS 2
+
+/* If TRUE, neither read nor write anything below cache_dir. The cache
+ * is only used when a directory is given for it.
+ */
+extern gboolean disable_cache;
+
+/* Where cache files are kept. */
+extern char *cache_dir;
+
+#endif
@@ -0,0 +1,162 @@
+#!/usr/bin/env python
+
+import os, shutil, subprocess, sys, tempfile, time
+from pkgchecker import PkgChecker
+
+# Each query with its expected output and errors, which are followed by
+# the record separator and exit status.
+queries = [
+    ('--modversion simple', '1.0.0', 0),
+    ('--static --libs simple', '-lsimple -lm', 0),
+    ('--exists simple >= 2.0', '', 1),
+    ('--exists simple', '', 0),
+    ('--libs nonexistent', '''Package nonexistent was not found in the pkg-config search path.
+Perhaps you should add the directory containing `nonexistent.pc'
+to the PKG_CONFIG_PATH environment variable
+No package 'nonexistent' found''', 1),
+    ('--short-errors --libs nonexistent', "No package 'nonexistent' found", 1),
+    # A fatal error only ends the query
+    ('--cflags missing-requires', '''Package pkg-non-existent-dep was not found in the pkg-config search path.
+Perhaps you should add the directory containing `pkg-non-existent-dep.pc'
+to the PKG_CONFIG_PATH environment variable
+Package 'pkg-non-existent-dep', required by 'missing-requires', not found''', 1),
+    ('--cflags missing-requires', '''Package pkg-non-existent-dep was not found in the pkg-config search path.
+Perhaps you should add the directory containing `pkg-non-existent-dep.pc'
+to the PKG_CONFIG_PATH environment variable
+Package 'pkg-non-existent-dep', required by 'missing-requires', not found''', 1),
+    ('--modversion missing-requires', '1.0.0', 0),
+    ('--static --cflags --libs requires-test', '-I/requires-test/include -I/private-dep/include -I/public-dep/include -L/requires-test/lib -L/private-dep/lib -L/public-dep/lib -lrequires-test -lprivate-dep -lpublic-dep', 0),
+    ('--variable=prefix simple', '/usr', 0),
+    ('--list-all', 'Unknown option --list-all', 1),
+    ('', 'Must specify package names on the command line', 1),
+]
+
+if __name__ == '__main__':
+    checker = PkgChecker(__file__, sys.argv)
+    env = os.environ.copy()
+    if 'PKG_CONFIG_PATH' in env:
+        del env['PKG_CONFIG_PATH']
+    env['PKG_CONFIG_LIBDIR'] = checker.data_dir
+    env['LC_ALL'] = 'C'
+    for var in ('PKG_CONFIG_DEBUG_SPEW', 'PKG_CONFIG_LOG'):
+        env.pop(var, None)
+
+    stdin = ''.join(q + '\n' for q, _, _ in queries)
+    expected = ''.join((out + '\n' if out else '') + '\x1e%d\n' % rc
+                       for _, out, rc in queries)
+    # Errors are flushed before the answer, so they come out in order
+    pc = subprocess.Popen([checker.pkgconfig_bin, '--batch'],
+                          universal_newlines=True,
+                          stdin=subprocess.PIPE,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT,
+                          env=env)
+    stdo, stde = pc.communicate(stdin)
+
+    errors = 0
+    if pc.returncode != 0:
+        print('Error running', checker.pkgconfig_bin, '--batch')
+        errors += 1
+    if stdo != expected:
+        print(' expected stdout:\n\n', expected)
+        print('\n received stdout:\n\n', stdo)
+        errors += 1
+
+    # Output options cannot be combined with --batch
+    pc = subprocess.Popen([checker.pkgconfig_bin, '--batch', '--libs', 'simple'],
+                          universal_newlines=True,
+                          stdin=subprocess.PIPE,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE,
+                          env=env)
+    stdo, stde = pc.communicate('')
+    if pc.returncode != 1:
+        print('--batch accepted output options')
+        errors += 1
+
+    # A query failing halfway through parsing a file leaves nothing behind
+    # for the next ones, whether they parse or load packages from the
+    # cache
+    cache_queries = [
+        ('--cflags variables-forward', "Variable 'prefix' not defined in '$srcdir/variables-forward.pc'", 1),
+        ('--cflags --static --libs simple', '-lsimple -lm', 0),
+        ('--cflags variables', '-DFOO=\\"/bar\\" -I/local/include -I/local/include/foo', 0),
+        ('--cflags variables-forward', "Variable 'prefix' not defined in '$srcdir/variables-forward.pc'", 1),
+        ('--static --libs requires-test', '-L/requires-test/lib -L/private-dep/lib -L/public-dep/lib -lrequires-test -lprivate-dep -lpublic-dep', 0),
+    ]
+    stdin = ''.join(q + '\n' for q, _, _ in cache_queries)
+    expected = checker.varsubst(''.join(out + '\n\x1e%d\n' % rc
+                                        for _, out, rc in cache_queries))
+    cache_dir = tempfile.mkdtemp()
+    cache_env = dict(env, PKG_CONFIG_CACHE_DIR=cache_dir)
+    for attempt in ('filling', 'filled'):
+        pc = subprocess.Popen([checker.pkgconfig_bin, '--batch'],
+                              universal_newlines=True,
+                              stdin=subprocess.PIPE,
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT,
+                              env=cache_env)
+        stdo, stde = pc.communicate(stdin)
+        if stdo != expected:
+            print(' expected stdout with the cache %s:\n\n' % attempt, expected)
+            print('\n received stdout:\n\n', stdo)
+            errors += 1
+    shutil.rmtree(cache_dir)
+
+    # Packages added or edited while --batch runs are found by the next
+    # query, even when they shadow or replace one loaded already, or are
+    # in a directory of the search path that did not exist yet
+    tmpdir = tempfile.mkdtemp()
+    created = os.path.join(tmpdir, 'created')
+    env['PKG_CONFIG_LIBDIR'] = os.pathsep.join((created, tmpdir,
+                                                checker.data_dir))
+    pc = subprocess.Popen([checker.pkgconfig_bin, '--batch'],
+                          universal_newlines=True,
+                          stdin=subprocess.PIPE,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE,
+                          env=env)
+
+    def query(q):
+        pc.stdin.write(q + '\n')
+        pc.stdin.flush()
+        out = ''
+        while True:
+            line = pc.stdout.readline()
+            if line.startswith('\x1e') or not line:
+                return out + line
+            out += line
+
+    def write_simple(version):
+        with open(os.path.join(tmpdir, 'simple.pc'), 'w') as f:
+            f.write('Name: simple\nDescription: simple\nVersion: %s\n' % version)
+
+    answers = [query('--exists later')]
+    with open(os.path.join(tmpdir, 'later.pc'), 'w') as f:
+        f.write('Name: later\nDescription: later\nVersion: 1.0\n')
+    answers.append(query('--exists later'))
+    answers.append(query('--modversion simple'))
+    write_simple('2.0.0')
+    # Backdate the directory so only the file, which was written too
+    # recently to be trusted, can tell its edit below apart
+    settled = time.time() - 60
+    os.utime(tmpdir, (settled, settled))
+    answers.append(query('--modversion simple'))
+    write_simple('3.0.0')
+    os.utime(tmpdir, (settled, settled))
+    answers.append(query('--modversion simple'))
+    os.mkdir(created)
+    with open(os.path.join(created, 'simple.pc'), 'w') as f:
+        f.write('Name: simple\nDescription: simple\nVersion: 4.0.0\n')
+    answers.append(query('--modversion simple'))
+    pc.communicate('')
+    shutil.rmtree(tmpdir)
+    expected = ['\x1e1\n', '\x1e0\n', '1.0.0\n\x1e0\n', '2.0.0\n\x1e0\n',
+                '3.0.0\n\x1e0\n', '4.0.0\n\x1e0\n']
+    if answers != expected:
+        print('Packages changed during --batch not found:')
+        print(' expected:', repr(expected))
+        print(' received:', repr(answers))
+        errors += 1
+
+    sys.exit(errors)
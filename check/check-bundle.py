@@ -0,0 +1,47 @@
+#!/usr/bin/env python
+
+import os, subprocess, sys
+from pkgchecker import PkgChecker
+
+env = {'PKG_CONFIG_LIBDIR': '${abs_srcdir}/bundle'}
+
+tests = [
+# Packages are found in the bundle and can require each other
+    (0, '1.0', '', env, ['--modversion', 'bundle-a']),
+    (0, '-I${abs_srcdir}/bundle/sub/include -L/bundle/lib -la -lb', '', env, ['--cflags', '--libs', 'bundle-a']),
+
+# Each package has its own pcfiledir
+    (0, '${abs_srcdir}/bundle', '', env, ['--variable=pcfiledir', 'bundle-a']),
+    (0, '${abs_srcdir}/bundle/sub', '', env, ['--variable=pcfiledir', 'bundle-b']),
+
+# The prefix is relocated relative to the pcfiledir of the package
+    (0, '-I${abs_srcdir}/bundle/include', '', env, ['--define-prefix', '--cflags', 'bundle-reloc']),
+    (0, '-I/reloc/include', '', env, ['--dont-define-prefix', '--cflags', 'bundle-reloc']),
+
+# A real file in the directory takes precedence over the bundle
+    (0, '2.0', '', env, ['--modversion', 'bundle-override']),
+    (1, '', '', env, ['--exists', 'bundle-missing']),
+    ]
+
+if __name__ == '__main__':
+    checker = PkgChecker(__file__, sys.argv)
+    errors = checker.check(tests)
+
+    # --list-all does not sort its output
+    expected = [
+        'bundle-a        bundle-a - First package of a bundle',
+        'bundle-b        bundle-b - Package with its own pcfiledir',
+        'bundle-override bundle-override - Takes precedence over the bundle',
+        'bundle-reloc    bundle-reloc - Relocatable package of a bundle',
+    ]
+    list_env = os.environ.copy()
+    list_env.pop('PKG_CONFIG_PATH', None)
+    list_env['PKG_CONFIG_LIBDIR'] = os.path.join(checker.data_dir, 'bundle')
+    stdo = subprocess.check_output([checker.pkgconfig_bin, '--list-all'],
+                                   universal_newlines=True, env=list_env)
+    if sorted(stdo.splitlines()) != expected:
+        print(' expected --list-all output:\n\n', '\n'.join(expected))
+        print('\n received:\n\n', stdo)
+        errors += 1
+
+    sys.exit(errors)
@@ -0,0 +1,127 @@
+#!/usr/bin/env python
+
+import os, shutil, subprocess, sys, tempfile
+from pkgchecker import PkgChecker
+
+def run(checker, env, args):
+    full_env = os.environ.copy()
+    full_env.pop('PKG_CONFIG_PATH', None)
+    full_env.pop('PKG_CONFIG_DISABLE_CACHE', None)
+    full_env.update(env)
+    full_env['LC_ALL'] = 'C'
+    pc = subprocess.Popen([checker.pkgconfig_bin] + args,
+                          universal_newlines=True,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE,
+                          env=full_env)
+    stdo, stde = pc.communicate()
+    return pc.returncode, stdo, stde
+
+# Queries answered the same with and without the cache
+queries = [
+    ['--modversion', 'simple'],
+    ['--cflags', '--libs', 'requires-test'],
+    ['--static', '--libs', 'requires-test'],
+    ['--print-requires-private', 'requires-test'],
+    ['--exists', 'nonexistent'],
+    ['--cflags', 'missing-requires'],
+    ['--variable=prefix', 'simple'],
+    ['--list-all'],
+]
+
+def write_pc(pcdir, name, version, mtime, extra=''):
+    pcfile = os.path.join(pcdir, name + '.pc')
+    with open(pcfile, 'w') as f:
+        f.write('Name: %s\nDescription: %s\nVersion: %s\n%s' % (name, name, version, extra))
+    # Files and directories modified in the last couple of seconds are
+    # not cached on disk, so pretend the change happened a while ago
+    os.utime(pcfile, (mtime, mtime))
+    os.utime(pcdir, (mtime, mtime))
+
+if __name__ == '__main__':
+    checker = PkgChecker(__file__, sys.argv)
+    errors = 0
+    tmpdir = tempfile.mkdtemp()
+    try:
+        pcdir = os.path.join(tmpdir, 'pc')
+        cachedir = os.path.join(tmpdir, 'cache')
+        os.mkdir(pcdir)
+        env = {'PKG_CONFIG_LIBDIR': pcdir, 'PKG_CONFIG_CACHE_DIR': cachedir}
+        write_pc(pcdir, 'cached', '1.0', 1000000000)
+
+        # Build the index, then answer from it
+        errors += checker.check([
+            (0, '1.0', '', env, ['--modversion', 'cached']),
+            (0, '1.0', '', env, ['--modversion', 'cached']),
+            (1, '', '', env, ['--exists', 'added']),
+        ])
+        if not os.listdir(cachedir):
+            print('No directory index was written to', cachedir)
+            errors += 1
+
+        # A changed directory has to be indexed again
+        write_pc(pcdir, 'added', '2.0', 1000000100)
+        errors += checker.check([
+            (0, '2.0', '', env, ['--modversion', 'added']),
+            (0, '1.0', '', env, ['--modversion', 'cached']),
+        ])
+
+        # Cached packages still see variables defined from the outside
+        write_pc(pcdir, 'vars', '1.0', 1000000200,
+                 'prefix=/foo\nincludedir=${prefix}/include\nCflags: -I${includedir}\n')
+        vars_env = dict(env, PKG_CONFIG_VARS_PREFIX='/env')
+        errors += checker.check([
+            (0, '-I/foo/include', '', env, ['--cflags', 'vars']),
+            (0, '-I/foo/include', '', env, ['--cflags', 'vars']),
+            (0, '-I/opt/include', '', env, ['--define-variable=prefix=/opt', '--cflags', 'vars']),
+            (0, '-I/env/include', '', vars_env, ['--cflags', 'vars']),
+            (0, '-I/foo/include', '', env, ['--cflags', 'vars']),
+        ])
+        if not [x for x in os.listdir(cachedir) if x.endswith('.package')]:
+            print('No compiled package was written to', cachedir)
+            errors += 1
+
+        # A changed file has to be parsed again
+        write_pc(pcdir, 'vars', '1.0', 1000000300,
+                 'prefix=/foo\nincludedir=${prefix}/inc\nCflags: -I${includedir}\n')
+        errors += checker.check([
+            (0, '-I/foo/inc', '', env, ['--cflags', 'vars']),
+        ])
+
+        # Nothing is written when the cache is disabled
+        shutil.rmtree(cachedir)
+        env['PKG_CONFIG_DISABLE_CACHE'] = '1'
+        errors += checker.check([
+            (0, '2.0', '', env, ['--modversion', 'added']),
+        ])
+        if os.path.exists(cachedir):
+            print('Cache directory', cachedir, 'written with the cache disabled')
+            errors += 1
+
+        # The cache is only used when a directory is given for it
+        home = os.path.join(tmpdir, 'home')
+        os.mkdir(home)
+        env = {'PKG_CONFIG_LIBDIR': checker.data_dir, 'PKG_CONFIG_CACHE_DIR': '',
+               'HOME': home, 'XDG_CACHE_HOME': os.path.join(home, 'cache')}
+        errors += checker.check([
+            (0, '1.0.0', '', env, ['--modversion', 'simple']),
+        ])
+        if os.listdir(home):
+            print('Cache written to', home, 'without a cache directory')
+            errors += 1
+
+        # Answers do not depend on whether the cache is used or filled
+        nocache = {'PKG_CONFIG_LIBDIR': checker.data_dir}
+        cache = dict(nocache, PKG_CONFIG_CACHE_DIR=cachedir)
+        for args in queries:
+            expected = run(checker, nocache, args)
+            for attempt in ('filling', 'filled'):
+                received = run(checker, cache, args)
+                if received != expected:
+                    print('\nError for', ' '.join(args), 'with the cache', attempt)
+                    print(' expected:', expected)
+                    print(' received:', received)
+                    errors += 1
+    finally:
+        shutil.rmtree(tmpdir)
+    sys.exit(errors)
@@ -12,6 +12,19 @@ Error printing enabled''', {'PKG_CONFIG_DEBUG_SPEW': '1'}, ['--version']),
          (0, '$PACKAGE_VERSION', '''Error printing enabled by default due to use of output options besides --exists, --atleast/exact/max-version or --list-all. Value of --silence-errors: 0
 Error printing enabled
 ''', {}, ['--debug', '--version']),
+         # Aliases and missing directories are pruned from the search path
+         (0, '$PACKAGE_VERSION', '''PKG_CONFIG_DEBUG_SPEW variable enabling debug spew
+Adding directory '$srcdir' from PKG_CONFIG_PATH
+Adding directory '$srcdir/.' from PKG_CONFIG_PATH
+Adding directory '$srcdir/missing' from PKG_CONFIG_PATH
+Global variable definition 'pc_sysrootdir' = '/'
+Global variable definition 'pc_top_builddir' = '$(top_builddir)'
+Dropping directory '$srcdir/.' from the search path, the same as '$srcdir'
+Dropping directory '$srcdir/missing' from the search path: No such file or directory
+Error printing enabled by default due to use of output options besides --exists, --atleast/exact/max-version or --list-all. Value of --silence-errors: 0
+Error printing enabled''', {'PKG_CONFIG_DEBUG_SPEW': '1',
+                            'PKG_CONFIG_LIBDIR': '$srcdir:$srcdir/.:$srcdir/missing'},
+          ['--version']),
 ]
 
 if __name__ == '__main__':
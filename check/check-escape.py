@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+
+import os, shutil, subprocess, sys, tempfile
+from pkgchecker import PkgChecker
+
+# Characters which have to be escaped to be passed through a shell
+def needs_escape(c):
+    return (c < 0x24 or 0x24 < c < 0x28 or 0x29 < c < 0x2B or
+            0x3A < c < 0x3D or 0x3D < c < 0x40 or 0x5A < c < 0x5E or
+            c == 0x60 or 0x7A < c < 0x7E or c > 0x7E)
+
+def run(checker, pcdir, name):
+    env = os.environ.copy()
+    env.pop('PKG_CONFIG_PATH', None)
+    env['PKG_CONFIG_LIBDIR'] = pcdir
+    env['LC_ALL'] = 'C'
+    pc = subprocess.Popen([checker.pkgconfig_bin, '--cflags', name],
+                          stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                          env=env)
+    stdo, stde = pc.communicate()
+    return pc.returncode, stdo.rstrip(b'\n')
+
+if __name__ == '__main__':
+    checker = PkgChecker(__file__, sys.argv)
+    errors = 0
+    tmpdir = tempfile.mkdtemp()
+    try:
+        # Every byte value but NUL and the line delimiter in one flag
+        chars = [c for c in range(1, 256) if c != 0x0A]
+        arg = b''
+        for c in chars:
+            if c == 0x0D:
+                arg += b'\r'
+            elif c == 0x23:
+                arg += b'\\#'
+            else:
+                arg += b'\\' + bytes([c])
+        expected = b'-DA'
+        for c in chars:
+            if needs_escape(c):
+                expected += b'\\'
+            expected += bytes([c])
+        expected += b'Z'
+
+        with open(os.path.join(tmpdir, 'bytes.pc'), 'wb') as f:
+            f.write(b'Name: bytes\nDescription: bytes\nVersion: 1.0\n'
+                    b'Cflags: -DA' + arg + b'Z\n')
+
+        # Leading and trailing whitespace of a flag is trimmed, but only
+        # the ASCII space characters count as such
+        with open(os.path.join(tmpdir, 'spaces.pc'), 'wb') as f:
+            f.write(b'Name: spaces\nDescription: spaces\nVersion: 1.0\n'
+                    b'Cflags: " \t\x0b\x0c\r-DB \t\x0b\x0c" "\xa0-DC\xa0"\n')
+
+        # Only the arguments of an option taking a separate one are
+        # escaped, which keeps it apart from a single argument
+        with open(os.path.join(tmpdir, 'pair.pc'), 'wb') as f:
+            f.write(b'Name: pair\nDescription: pair\nVersion: 1.0\n'
+                    b'Cflags: -isystem "/a b" "-isystem /a b"\n')
+
+        for name, out in (('bytes', expected),
+                          ('spaces', b'-DB \\\xa0-DC\\\xa0'),
+                          ('pair', b'-isystem\\ /a\\ b -isystem /a\\ b')):
+            rc, stdo = run(checker, tmpdir, name)
+            if rc != 0 or stdo != out:
+                print('--cflags', name, 'returned', rc)
+                print(' expected stdout:', repr(out))
+                print(' received stdout:', repr(stdo))
+                errors += 1
+    finally:
+        shutil.rmtree(tmpdir)
+    sys.exit(errors)
@@ -0,0 +1,21 @@
+#!/usr/bin/env python
+import sys
+from pkgchecker import PkgChecker
+
+tests = [
+
+# Fields that are not needed for the output are not parsed, so the broken
+# Libs only matter when asking for them
+    (0, '1.0.0', '', {}, ['--modversion', 'unparsed-libs']),
+    (0, '-I/unparsed-libs/include', '', {}, ['--cflags', 'unparsed-libs']),
+    (0, '/usr/lib', '', {}, ['--variable=libdir', 'unparsed-libs']),
+    (0, '', '', {}, ['--exists', 'unparsed-libs']),
+    (1, '', '', {}, ['--silence-errors', '--libs', 'unparsed-libs']),
+
+# --validate still checks every field
+    (1, '', '', {}, ['--silence-errors', '--validate', 'unparsed-libs']),
+]
+
+if __name__ == '__main__':
+    checker = PkgChecker(__file__, sys.argv)
+    sys.exit(checker.check(tests))
@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+
+import os, shutil, subprocess, sys, tempfile
+from pkgchecker import PkgChecker
+
+def write_pc(pcdir, name, version, mtime, extra='', description=None):
+    pcfile = os.path.join(pcdir, name + '.pc')
+    if description is None:
+        description = name + ' package'
+    with open(pcfile, 'w') as f:
+        f.write('Name: %s\nDescription: %s\nVersion: %s\n%s' %
+                (name, description, version, extra))
+    # --build-index waits for directories modified in the last couple
+    # of seconds, so pretend the change happened a while ago
+    os.utime(pcfile, (mtime, mtime))
+    os.utime(pcdir, (mtime, mtime))
+
+def build_index(checker, pcdir):
+    pc = subprocess.Popen([checker.pkgconfig_bin, '--debug',
+                           '--build-index', pcdir],
+                          universal_newlines=True,
+                          stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    stdo, stde = pc.communicate()
+    if pc.returncode != 0:
+        print('--build-index', pcdir, 'failed:', stde)
+        return [], 1
+    indexed = [line for line in stde.splitlines()
+               if line.startswith('Indexing ')]
+    return indexed, 0
+
+def list_all(checker, env):
+    full_env = os.environ.copy()
+    full_env.pop('PKG_CONFIG_PATH', None)
+    full_env.update(env)
+    stdo = subprocess.check_output([checker.pkgconfig_bin, '--list-all'],
+                                   universal_newlines=True, env=full_env)
+    return sorted(stdo.splitlines())
+
+if __name__ == '__main__':
+    checker = PkgChecker(__file__, sys.argv)
+    errors = 0
+    tmpdir = tempfile.mkdtemp()
+    try:
+        pcdir = os.path.join(tmpdir, 'pc')
+        os.mkdir(pcdir)
+        env = {'PKG_CONFIG_LIBDIR': pcdir, 'PKG_CONFIG_DISABLE_CACHE': '1'}
+        write_pc(pcdir, 'base', '1.0', 1000000000,
+                 'prefix=/base\nLibs: -L${prefix}/lib -lbase\n')
+        write_pc(pcdir, 'app', '2.0', 1000000000,
+                 'Requires: base >= 1.0\nCflags: -DAPP\n')
+
+        indexed, failed = build_index(checker, pcdir)
+        errors += failed
+        if not os.path.exists(pcdir + '.index'):
+            print('No index was written next to', pcdir)
+            errors += 1
+        if len(indexed) != 2:
+            print('Expected 2 packages to be indexed, got', indexed)
+            errors += 1
+
+        # Queries are answered from the index, flags from the files
+        errors += checker.check([
+            (0, '2.0', '', env, ['--modversion', 'app']),
+            (0, 'base >= 1.0', '', env, ['--print-requires', 'app']),
+            (1, '', '', env, ['--exists', 'app >= 3']),
+            (1, '', '', env, ['--exists', 'missing']),
+            (0, '-DAPP -L/base/lib -lbase', '', env, ['--cflags', '--libs', 'app']),
+            (0, '/base', '', env, ['--variable=prefix', 'base']),
+        ])
+        if list_all(checker, env) != ['app  app - app package', 'base base - base package']:
+            print('Unexpected --list-all output', list_all(checker, env))
+            errors += 1
+
+        # A package edited in place since the index was built is read from
+        # its file, even with the same size and mtime
+        write_pc(pcdir, 'base', '1.5', 1000000000, description='edit package')
+        errors += checker.check([
+            (0, '1.5', '', env, ['--modversion', 'base']),
+        ])
+        if list_all(checker, env) != ['app  app - app package', 'base base - edit package']:
+            print('Unexpected --list-all output after an edit', list_all(checker, env))
+            errors += 1
+
+        # Adding a package makes the index stale until it is rebuilt, which
+        # only reads the new and changed files
+        write_pc(pcdir, 'added', '3.0', 1000000200)
+        errors += checker.check([
+            (0, '3.0', '', env, ['--modversion', 'added']),
+        ])
+        indexed, failed = build_index(checker, pcdir)
+        errors += failed
+        if sorted(os.path.basename(line.split("'")[1]) for line in indexed) != \
+           ['added.pc', 'base.pc']:
+            print('Expected only added.pc and base.pc to be indexed, got',
+                  indexed)
+            errors += 1
+        errors += checker.check([
+            (0, '3.0', '', env, ['--modversion', 'added']),
+            (0, '1.5', '', env, ['--modversion', 'base']),
+        ])
+
+        # Removed packages are dropped from the index
+        os.remove(os.path.join(pcdir, 'added.pc'))
+        os.utime(pcdir, (1000000300, 1000000300))
+        indexed, failed = build_index(checker, pcdir)
+        errors += failed
+        errors += checker.check([
+            (1, '', '', env, ['--exists', 'added']),
+            (0, '2.0', '', env, ['--modversion', 'app']),
+        ])
+    finally:
+        shutil.rmtree(tmpdir)
+    sys.exit(errors)
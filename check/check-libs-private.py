@@ -4,8 +4,25 @@ import sys
 from pkgchecker import PkgChecker
 
 tests = [(0, '-lsimple -lm', '', {}, ['--static', '--libs', 'simple']),
+
+# Libs.private is kept apart from Libs, but output in the original order
+         (0, '-L/private-first/lib -lm -lprivate-first', '', {}, ['--static', '--libs', 'private-first']),
+         (0, '-lm -lprivate-first', '', {}, ['--static', '--libs-only-l', 'private-first']),
+
+# Libs.private is only split for static links, so one that cannot be
+# split leaves the other queries alone
+         (0, '1.0.0', '', {}, ['--modversion', 'broken-libs-private']),
+         (1, '', '', {}, ['--silence-errors', '--static', '--libs', 'broken-libs-private']),
+         (1, '', '', {}, ['--silence-errors', '--static', '--validate', 'broken-libs-private']),
+]
+
+dynamic_tests = [(0, '-L/broken/lib -lbroken-libs-private', '', {}, ['--libs', 'broken-libs-private']),
+                 (0, '', '', {}, ['--validate', 'broken-libs-private']),
 ]
 
 if __name__ == '__main__':
     checker = PkgChecker(__file__, sys.argv)
+    # Without indirect dependencies, --libs links dynamically by default
+    if checker.replacements['list_indirect_deps'] in ('no', 'FALSE'):
+        tests += dynamic_tests
     sys.exit(checker.check(tests))
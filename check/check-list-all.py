@@ -0,0 +1,38 @@
+#!/usr/bin/env python
+
+import os, shutil, subprocess, sys, tempfile
+from pkgchecker import PkgChecker
+
+if __name__ == '__main__':
+    checker = PkgChecker(__file__, sys.argv)
+    errors = 0
+
+    # Files may be parsed by several threads, but what they report comes
+    # out in the order the files are listed, every time
+    tmpdir = tempfile.mkdtemp()
+    for i in range(64):
+        with open(os.path.join(tmpdir, 'list-%d.pc' % i), 'w') as f:
+            f.write('Name: list-%d\nDescription: ${undefined}\nVersion: 1.0\n' % i)
+    expected = ''.join("Variable 'undefined' not defined in '%s'\n"
+                       % os.path.join(tmpdir, name)
+                       for name in os.listdir(tmpdir))
+
+    env = os.environ.copy()
+    env.pop('PKG_CONFIG_PATH', None)
+    env['PKG_CONFIG_LIBDIR'] = tmpdir
+    for attempt in range(5):
+        pc = subprocess.Popen([checker.pkgconfig_bin, '--list-all',
+                               '--print-errors'],
+                              universal_newlines=True,
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.PIPE,
+                              env=env)
+        stdo, stde = pc.communicate()
+        if stde != expected:
+            print(' expected stderr:\n\n', expected)
+            print('\n received stderr:\n\n', stde)
+            errors += 1
+            break
+    shutil.rmtree(tmpdir)
+
+    sys.exit(errors)
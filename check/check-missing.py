@@ -1,5 +1,5 @@
 #!/usr/bin/env python
-import sys
+import os, shutil, subprocess, sys, tempfile
 from pkgchecker import PkgChecker
 
 tests = [
@@ -55,4 +55,33 @@ tests = [
 
 if __name__ == '__main__':
     checker = PkgChecker(__file__, sys.argv)
-    sys.exit(checker.check(tests))
+    errors = checker.check(tests)
+
+    # A .pc name that is not a regular file is skipped without opening it
+    # for good, so a FIFO does not hang the lookup
+    if hasattr(os, 'mkfifo'):
+        tmpdir = tempfile.mkdtemp()
+        os.mkfifo(os.path.join(tmpdir, 'simple.pc'))
+        os.mkfifo(os.path.join(tmpdir, 'fifo.pc'))
+        env = os.environ.copy()
+        env.pop('PKG_CONFIG_PATH', None)
+        env['PKG_CONFIG_LIBDIR'] = os.pathsep.join((tmpdir, checker.data_dir))
+        for args, expected in ((['--modversion', 'simple'], (0, '1.0.0\n')),
+                               (['--exists', 'fifo'], (1, ''))):
+            try:
+                pc = subprocess.run([checker.pkgconfig_bin] + args,
+                                    universal_newlines=True,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.PIPE,
+                                    env=env, timeout=30)
+                received = (pc.returncode, pc.stdout)
+            except subprocess.TimeoutExpired:
+                received = 'timed out'
+            if received != expected:
+                print('Error for', ' '.join(args), 'with FIFOs in the path')
+                print(' expected:', expected)
+                print(' received:', received)
+                errors += 1
+        shutil.rmtree(tmpdir)
+
+    sys.exit(errors)
@@ -24,6 +24,12 @@ prefix''', '', {}, ['--print-variables', 'simple']),
 sub2   Subdirectory package 2 - Test package 2 for subdirectory
 broken Broken package - Module with broken .pc file''', '', {'PKG_CONFIG_LIBDIR': '$srcdir/sub'}, ['--list-all']),
 
+# --list-all, the first package of a name in the search path wins, and
+# entries that are not files do not count
+         (0, '''sub1   Shadowing package 1 - Test package shadowing sub1 later in the search path
+sub2   Subdirectory package 2 - Test package 2 for subdirectory
+broken Broken package - Module with broken .pc file''', '', {'PKG_CONFIG_PATH': '$srcdir/shadow', 'PKG_CONFIG_LIBDIR': '$srcdir/sub'}, ['--list-all']),
+
 # Check handling when multiple incompatible options are set
          (0, '$PACKAGE_VERSION', 'Ignoring incompatible output option "--modversion"', {}, ['--version', '--modversion', 'simple']),
 
@@ -12,6 +12,17 @@ tests = [
 
 # Test <=, < and != succeed
     (0, '', '', {}, ['--exists', 'requires-version-3']),
+
+# Modules are separated by commas and whitespace
+    (0, '', '', {}, ['--exists', 'simple >= 1.0,, simple, simple < 2.0']),
+
+# The operator has to be followed by whitespace and a version
+    (1, '', "Unknown version comparison operator '>=1.0' after package name 'simple' in file '(command line arguments)'",
+     {}, ['--print-errors', '--exists', 'simple >=1.0']),
+    (1, '', "Comparison operator but no version after package name 'simple' in file '(command line arguments)'",
+     {}, ['--print-errors', '--exists', 'simple >= ,simple']),
+    (1, '', "Empty package name in Requires or Conflicts in file '(command line arguments)'",
+     {}, ['--print-errors', '--exists', 'simple ,']),
     ]
 
 
@@ -13,6 +13,12 @@ tests = [
 
 # Check the entire cflags output
     (0, '-DFOO=\\"/bar\\" -I/local/include -I/local/include/foo', '', {}, ['--cflags', 'variables']),
+
+# Variables can only refer to the ones defined before them, even when
+# they are not used
+    (1, '', "Variable 'prefix' not defined in '$abs_srcdir/variables-forward.pc'", {}, ['--libs', 'variables-forward']),
+    (0, '/opt/share/man', '', {}, ['--define-variable=prefix=/opt', '--variable=mandir', 'variables-forward']),
+    (0, '-L/opt/lib -lforward', '', {}, ['--define-variable=prefix=/opt', '--libs', 'variables-forward']),
 ]
 
 if __name__ == '__main__':
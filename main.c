@@ -23,11 +23,14 @@
 
 #include "pkg.h"
 #include "parse.h"
+#include "cache.h"
+#include "pkgindex.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <setjmp.h>
 
 #ifdef G_OS_WIN32
 #define STRICT
@@ -61,13 +64,48 @@ static gboolean want_debug_spew = FALSE;
 static gboolean want_verbose_errors = FALSE;
 static gboolean want_stdout_errors = FALSE;
 static gboolean output_opt_set = FALSE;
+static gboolean vercmp_opt_set = FALSE;
+static gboolean want_batch = FALSE;
+static gboolean want_build_index = FALSE;
+
+/* Number of errors reported by each thread */
+static GPrivate error_count = G_PRIVATE_INIT (NULL);
+
+/* Where fatal_error() returns to while answering a --batch query */
+static jmp_buf batch_query_env;
+static gboolean in_batch_query = FALSE;
+
+/* Messages of the calling thread are collected here rather than printed
+ * while it is set, see collect_messages().
+ */
+static GPrivate message_buffer = G_PRIVATE_INIT (NULL);
+
+static void
+print_message (const char *str)
+{
+  GString *buffer = g_private_get (&message_buffer);
+  FILE* stream;
+
+  if (buffer != NULL)
+    {
+      g_string_append (buffer, str);
+      return;
+    }
+
+  if (want_stdout_errors)
+    stream = stdout;
+  else
+    stream = stderr;
+
+  fputs (str, stream);
+  fflush (stream);
+}
 
 void
 debug_spew (const char *format, ...)
 {
   va_list args;
   gchar *str;
-  FILE* stream;
 
   g_return_if_fail (format != NULL);
 
@@ -78,13 +116,7 @@ debug_spew (const char *format, ...)
   str = g_strdup_vprintf (format, args);
   va_end (args);
 
-  if (want_stdout_errors)
-    stream = stdout;
-  else
-    stream = stderr;
-
-  fputs (str, stream);
-  fflush (stream);
+  print_message (str);
 
   g_free (str);
 }
@@ -94,10 +126,12 @@ verbose_error (const char *format, ...)
 {
   va_list args;
   gchar *str;
-  FILE* stream;
   
   g_return_if_fail (format != NULL);
 
+  g_private_set (&error_count,
+                 GUINT_TO_POINTER (verbose_error_count () + 1));
+
   if (!want_verbose_errors)
     return;
 
@@ -105,17 +139,39 @@ verbose_error (const char *format, ...)
   str = g_strdup_vprintf (format, args);
   va_end (args);
 
-  if (want_stdout_errors)
-    stream = stdout;
-  else
-    stream = stderr;
-  
-  fputs (str, stream);
-  fflush (stream);
+  print_message (str);
 
   g_free (str);
 }
 
+void
+collect_messages (GString *buffer)
+{
+  g_private_set (&message_buffer, buffer);
+}
+
+void
+print_messages (const GString *buffer)
+{
+  print_message (buffer->str);
+}
+
+guint
+verbose_error_count (void)
+{
+  return GPOINTER_TO_UINT (g_private_get (&error_count));
+}
+
+/* See pkg.h for where this may be called from */
+void
+fatal_error (void)
+{
+  if (in_batch_query)
+    longjmp (batch_query_env, 1);
+
+  exit (1);
+}
+
 static gboolean
 define_variable_cb (const char *opt, const char *arg, gpointer data,
                     GError **error)
@@ -157,8 +213,6 @@ static gboolean
 output_opt_cb (const char *opt, const char *arg, gpointer data,
                GError **error)
 {
-  static gboolean vercmp_opt_set = FALSE;
-
   /* only allow one output mode, with a few exceptions */
   if (output_opt_set)
     {
@@ -359,6 +413,12 @@ process_package_args (const char *cmdline, GList **packages, FILE *log)
       else
         req = get_package (ver->name);
 
+      /* Libs.private is only split for static links, which --validate
+       * checks it for as it always did.
+       */
+      if (req != NULL && want_validate && want_static_lib_list)
+        package_get_libs_private (req);
+
       if (log != NULL)
         {
           if (req == NULL)
@@ -479,93 +539,50 @@ static const GOptionEntry options_table[] = {
   { "msvc-syntax", 0, 0, G_OPTION_ARG_NONE, &msvc_syntax,
     "output -l and -L flags for the Microsoft compiler (cl)", NULL },
 #endif
+  { "batch", 0, 0, G_OPTION_ARG_NONE, &want_batch,
+    "answer queries read from stdin, one per line", NULL },
+  { "build-index", 0, 0, G_OPTION_ARG_NONE, &want_build_index,
+    "write the package index of the directories given on the command "
+    "line, or of the search path, and exit", NULL },
   { NULL, 0, 0, 0, NULL, NULL, NULL }
 };
 
-int
-main (int argc, char **argv)
+/* The options that can be given with each --batch query */
+static const char *batch_option_names[] = {
+  "modversion", "libs", "static", "short-errors", "libs-only-l",
+  "libs-only-other", "libs-only-L", "cflags", "cflags-only-I",
+  "cflags-only-other", "variable", "exists", "print-variables",
+  "uninstalled", "atleast-version", "exact-version", "max-version",
+  "print-errors", "silence-errors", "print-provides", "print-requires",
+  "print-requires-private", "validate", NULL
+};
+
+static FILE *
+open_log (void)
 {
-  GString *str;
-  GList *packages = NULL;
-  char *search_path;
-  char *pcbuilddir;
-  gboolean need_newline;
   FILE *log = NULL;
-  GError *error = NULL;
-  GOptionContext *opt_context;
-
-  /* This is here so that we get debug spew from the start,
-   * during arg parsing
-   */
-  if (getenv ("PKG_CONFIG_DEBUG_SPEW"))
-    {
-      want_debug_spew = TRUE;
-      want_verbose_errors = TRUE;
-      want_silence_errors = FALSE;
-      debug_spew ("PKG_CONFIG_DEBUG_SPEW variable enabling debug spew\n");
-    }
-
-
-  /* Get the built-in search path */
-  init_pc_path ();
-  if (pkg_config_pc_path == NULL)
-    {
-      /* Even when we override the built-in search path, we still use it later
-       * to add pc_path to the virtual pkg-config package.
-       */
-      verbose_error ("Failed to get default search path\n");
-      exit (1);
-    }
-
-  search_path = getenv ("PKG_CONFIG_PATH");
-  if (search_path) 
-    {
-      add_search_dirs(search_path, G_SEARCHPATH_SEPARATOR_S);
-    }
-  if (getenv("PKG_CONFIG_LIBDIR") != NULL) 
-    {
-      add_search_dirs(getenv("PKG_CONFIG_LIBDIR"), G_SEARCHPATH_SEPARATOR_S);
-    }
-  else
-    {
-      add_search_dirs(pkg_config_pc_path, G_SEARCHPATH_SEPARATOR_S);
-    }
-
-  pcsysrootdir = getenv ("PKG_CONFIG_SYSROOT_DIR");
-  if (pcsysrootdir)
-    {
-      define_global_variable ("pc_sysrootdir", pcsysrootdir);
-    }
-  else
-    {
-      define_global_variable ("pc_sysrootdir", "/");
-    }
 
-  pcbuilddir = getenv ("PKG_CONFIG_TOP_BUILD_DIR");
-  if (pcbuilddir)
-    {
-      define_global_variable ("pc_top_builddir", pcbuilddir);
-    }
-  else
+  if (getenv("PKG_CONFIG_LOG") != NULL)
     {
-      /* Default appropriate for automake */
-      define_global_variable ("pc_top_builddir", "$(top_builddir)");
+      log = fopen (getenv ("PKG_CONFIG_LOG"), "a");
+      if (log == NULL)
+	{
+	  fprintf (stderr, "Cannot open log file: %s\n",
+		   getenv ("PKG_CONFIG_LOG"));
+	  exit (1);
+	}
     }
 
-  if (getenv ("PKG_CONFIG_DISABLE_UNINSTALLED"))
-    {
-      debug_spew ("disabling auto-preference for uninstalled packages\n");
-      disable_uninstalled = TRUE;
-    }
+  return log;
+}
 
-  /* Parse options */
-  opt_context = g_option_context_new (NULL);
-  g_option_context_add_main_entries (opt_context, options_table, NULL);
-  if (!g_option_context_parse(opt_context, &argc, &argv, &error))
-    {
-      fprintf (stderr, "%s\n", error->message);
-      return 1;
-    }
+/* Settle how errors are reported and which fields of the .pc files are
+ * needed for the output options that were given.
+ */
+static void
+setup_query (void)
+{
+  FieldMask fields = 0;
 
   /* If no output option was set, then --exists is the default. */
   if (!output_opt_set)
@@ -608,83 +625,62 @@ main (int argc, char **argv)
   else
     debug_spew ("Error printing disabled\n");
 
-  if (want_static_lib_list)
-    enable_private_libs();
+  /* Only parse the fields of the .pc files that the output is made of,
+   * so that for instance --modversion does not split up any Libs.
+   * --validate checks all the fields it always did, which does not
+   * include the dependencies.
+   */
+  if (want_validate)
+    {
+      fields = FIELD_CONFLICTS | FIELD_LIBS | FIELD_CFLAGS;
+    }
   else
-    disable_private_libs();
-
-  /* honor Requires.private if any Cflags are requested or any static
-   * libs are requested */
+    {
+      if (pkg_flags & CFLAGS_ANY)
+        fields |= FIELD_CFLAGS;
 
-  if (pkg_flags & CFLAGS_ANY || want_requires_private || want_exists ||
-      (want_static_lib_list && (pkg_flags & LIBS_ANY)))
-    enable_requires_private();
+      if (pkg_flags & LIBS_ANY)
+        fields |= FIELD_LIBS;
 
-  /* ignore Requires if no Cflags or Libs are requested */
+      /* honor Requires.private if any Cflags are requested or any static
+       * libs are requested */
 
-  if (pkg_flags == 0 && !want_requires && !want_exists)
-    disable_requires();
+      if (pkg_flags & CFLAGS_ANY || want_requires_private || want_exists ||
+          (want_static_lib_list && (pkg_flags & LIBS_ANY)))
+        fields |= FIELD_REQUIRES_PRIVATE;
 
-  /* Allow errors in .pc files when listing all. */
-  if (want_list)
-    parse_strict = FALSE;
+      /* ignore Requires if no Cflags or Libs are requested */
 
-  if (want_my_version)
-    {
-      printf ("%s\n", VERSION);
-      return 0;
-    }
+      if (pkg_flags != 0 || want_requires || want_exists)
+        fields |= FIELD_REQUIRES;
 
-  if (required_pkgconfig_version)
-    {
-      if (compare_versions (VERSION, required_pkgconfig_version) >= 0)
-        return 0;
-      else
-        return 1;
+      /* Conflicts are only checked against the dependencies */
+      if (fields & (FIELD_REQUIRES | FIELD_REQUIRES_PRIVATE))
+        fields |= FIELD_CONFLICTS;
     }
 
-  package_init (want_list);
+  parse_fields = fields;
 
+  /* Allow errors in .pc files when listing all. */
   if (want_list)
-    {
-      print_package_list ();
-      return 0;
-    }
-
-  /* Collect packages from remaining args */
-  str = g_string_new ("");
-  while (argc > 1)
-    {
-      argc--;
-      argv++;
-
-      g_string_append (str, *argv);
-      g_string_append (str, " ");
-    }
-
-  g_option_context_free (opt_context);
-
-  g_strstrip (str->str);
+    parse_strict = FALSE;
+}
 
-  if (getenv("PKG_CONFIG_LOG") != NULL)
-    {
-      log = fopen (getenv ("PKG_CONFIG_LOG"), "a");
-      if (log == NULL)
-	{
-	  fprintf (stderr, "Cannot open log file: %s\n",
-		   getenv ("PKG_CONFIG_LOG"));
-	  exit (1);
-	}
-    }
+/* Answer a query about the packages listed in CMDLINE once the options
+ * have been set up, returning the exit status.
+ */
+static int
+run_query (const char *cmdline, FILE *log)
+{
+  GList *packages = NULL;
+  gboolean need_newline;
 
   /* find and parse each of the packages specified */
-  if (!process_package_args (str->str, &packages, log))
+  if (!process_package_args (cmdline, &packages, log))
     return 1;
 
   if (log != NULL)
-    fclose (log);
-
-  g_string_free (str, TRUE);
+    fflush (log);
 
   /* If the user just wants to check package existence or validate its .pc
    * file, we're all done. */
@@ -825,7 +821,8 @@ main (int argc, char **argv)
 
   if (pkg_flags != 0)
     {
-      char *str = packages_get_flags (packages, pkg_flags);
+      char *str = packages_get_flags (packages, pkg_flags,
+                                      want_static_lib_list);
       printf ("%s", str);
       g_free (str);
       need_newline = TRUE;
@@ -836,3 +833,385 @@ main (int argc, char **argv)
 
   return 0;
 }
+
+static void
+reset_output_options (void)
+{
+  want_version = FALSE;
+  pkg_flags = 0;
+  g_free (variable_name);
+  variable_name = NULL;
+  want_exists = FALSE;
+  want_uninstalled = FALSE;
+  want_variable_list = FALSE;
+  g_free (required_atleast_version);
+  required_atleast_version = NULL;
+  g_free (required_exact_version);
+  required_exact_version = NULL;
+  g_free (required_max_version);
+  required_max_version = NULL;
+  want_provides = FALSE;
+  want_requires = FALSE;
+  want_requires_private = FALSE;
+  want_validate = FALSE;
+  output_opt_set = FALSE;
+  vercmp_opt_set = FALSE;
+}
+
+static gboolean
+read_query (FILE *stream, GString *line)
+{
+  char buf[1024];
+
+  g_string_truncate (line, 0);
+  while (fgets (buf, sizeof (buf), stream) != NULL)
+    {
+      g_string_append (line, buf);
+      if (line->str[line->len - 1] == '\n')
+        break;
+    }
+
+  if (line->len == 0)
+    return FALSE;
+
+  while (line->len > 0 &&
+         (line->str[line->len - 1] == '\n' ||
+          line->str[line->len - 1] == '\r'))
+    g_string_truncate (line, line->len - 1);
+
+  return TRUE;
+}
+
+static int
+run_batch_query (const char *query, const GOptionEntry *query_options,
+                 FILE *log)
+{
+  GOptionContext *opt_context;
+  GError *error = NULL;
+  GString *str;
+  char *cmdline;
+  char **argv;
+  int argc;
+  int i;
+  int status;
+
+  debug_spew ("Batch query '%s'\n", query);
+
+  /* Parse the query like a command line */
+  cmdline = g_strconcat ("pkg-config ", query, NULL);
+  if (!g_shell_parse_argv (cmdline, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      fflush (stderr);
+      g_error_free (error);
+      g_free (cmdline);
+      return 1;
+    }
+  g_free (cmdline);
+
+  opt_context = g_option_context_new (NULL);
+  g_option_context_set_help_enabled (opt_context, FALSE);
+  g_option_context_add_main_entries (opt_context, query_options, NULL);
+  if (!g_option_context_parse (opt_context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      fflush (stderr);
+      g_error_free (error);
+      g_option_context_free (opt_context);
+      g_strfreev (argv);
+      return 1;
+    }
+  g_option_context_free (opt_context);
+
+  setup_query ();
+  package_init (FALSE);
+
+  str = g_string_new ("");
+  for (i = 1; i < argc; i++)
+    {
+      g_string_append (str, argv[i]);
+      g_string_append (str, " ");
+    }
+  g_strfreev (argv);
+  g_strstrip (str->str);
+
+  status = run_query (str->str, log);
+  g_string_free (str, TRUE);
+
+  return status;
+}
+
+/* Answer queries read from stdin, one per line. A query is made of the
+ * options in batch_option_names and package names, as on the command
+ * line, and the other options given with --batch apply to all queries.
+ * The output of each query is followed by a line with an ASCII record
+ * separator and the exit status the query would have had on its own.
+ */
+static int
+run_batch (FILE *log)
+{
+  GOptionEntry *query_options;
+  const GOptionEntry *entry;
+  GString *line;
+  gboolean default_static_lib_list = want_static_lib_list;
+  gboolean default_short_errors = want_short_errors;
+  gboolean default_verbose_errors = want_verbose_errors;
+  gboolean default_silence_errors = want_silence_errors;
+  int n_options = 0;
+
+  query_options = g_new0 (GOptionEntry, G_N_ELEMENTS (options_table));
+  for (entry = options_table; entry->long_name != NULL; entry++)
+    {
+      const char **name;
+
+      for (name = batch_option_names; *name != NULL; name++)
+        if (strcmp (entry->long_name, *name) == 0)
+          {
+            query_options[n_options++] = *entry;
+            break;
+          }
+    }
+
+  line = g_string_new (NULL);
+  while (read_query (stdin, line))
+    {
+      int status;
+
+      reset_output_options ();
+      want_static_lib_list = default_static_lib_list;
+      want_short_errors = default_short_errors;
+      want_verbose_errors = default_verbose_errors;
+      want_silence_errors = default_silence_errors;
+
+      in_batch_query = TRUE;
+      if (setjmp (batch_query_env) == 0)
+        status = run_batch_query (line->str, query_options, log);
+      else
+        {
+          /* Packages loaded by the failed query may be incomplete */
+          status = 1;
+          package_reset ();
+        }
+      in_batch_query = FALSE;
+
+      fflush (stderr);
+      printf ("\036%d\n", status);
+      fflush (stdout);
+    }
+
+  g_string_free (line, TRUE);
+  g_free (query_options);
+
+  return 0;
+}
+
+static gboolean
+build_index (const char *dirname)
+{
+  GError *error = NULL;
+
+  if (pkg_index_build (dirname, &error))
+    return TRUE;
+
+  fprintf (stderr, "Cannot build the package index of '%s': %s\n",
+           dirname, error->message);
+  g_error_free (error);
+
+  return FALSE;
+}
+
+/* Index the directories in DIRS, or the ones of the search path if there
+ * are none.
+ */
+static int
+build_indexes (int n_dirs, char **dirs)
+{
+  gboolean ok = TRUE;
+  int i;
+
+  if (n_dirs == 0)
+    {
+      GList *paths = get_search_dir_paths ();
+      GList *iter;
+
+      for (iter = paths; iter != NULL; iter = g_list_next (iter))
+        ok = build_index (iter->data) && ok;
+      g_list_free (paths);
+    }
+
+  for (i = 0; i < n_dirs; i++)
+    ok = build_index (dirs[i]) && ok;
+
+  return ok ? 0 : 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  GString *str;
+  char *search_path;
+  char *pcbuilddir;
+  FILE *log = NULL;
+  int status;
+  GError *error = NULL;
+  GOptionContext *opt_context;
+
+  /* This is here so that we get debug spew from the start,
+   * during arg parsing
+   */
+  if (getenv ("PKG_CONFIG_DEBUG_SPEW"))
+    {
+      want_debug_spew = TRUE;
+      want_verbose_errors = TRUE;
+      want_silence_errors = FALSE;
+      debug_spew ("PKG_CONFIG_DEBUG_SPEW variable enabling debug spew\n");
+    }
+
+
+  /* Get the built-in search path */
+  init_pc_path ();
+  if (pkg_config_pc_path == NULL)
+    {
+      /* Even when we override the built-in search path, we still use it later
+       * to add pc_path to the virtual pkg-config package.
+       */
+      verbose_error ("Failed to get default search path\n");
+      exit (1);
+    }
+
+  search_path = getenv ("PKG_CONFIG_PATH");
+  if (search_path) 
+    {
+      add_search_dirs(search_path, G_SEARCHPATH_SEPARATOR_S);
+    }
+  if (getenv("PKG_CONFIG_LIBDIR") != NULL) 
+    {
+      add_search_dirs(getenv("PKG_CONFIG_LIBDIR"), G_SEARCHPATH_SEPARATOR_S);
+    }
+  else
+    {
+      add_search_dirs(pkg_config_pc_path, G_SEARCHPATH_SEPARATOR_S);
+    }
+
+  pcsysrootdir = getenv ("PKG_CONFIG_SYSROOT_DIR");
+  if (pcsysrootdir)
+    {
+      define_global_variable ("pc_sysrootdir", pcsysrootdir);
+    }
+  else
+    {
+      define_global_variable ("pc_sysrootdir", "/");
+    }
+
+  pcbuilddir = getenv ("PKG_CONFIG_TOP_BUILD_DIR");
+  if (pcbuilddir)
+    {
+      define_global_variable ("pc_top_builddir", pcbuilddir);
+    }
+  else
+    {
+      /* Default appropriate for automake */
+      define_global_variable ("pc_top_builddir", "$(top_builddir)");
+    }
+
+  if (getenv ("PKG_CONFIG_DISABLE_UNINSTALLED"))
+    {
+      debug_spew ("disabling auto-preference for uninstalled packages\n");
+      disable_uninstalled = TRUE;
+    }
+
+  if (getenv ("PKG_CONFIG_DISABLE_CACHE"))
+    {
+      debug_spew ("disabling the package cache\n");
+    }
+  else if (getenv ("PKG_CONFIG_CACHE_DIR") &&
+           *getenv ("PKG_CONFIG_CACHE_DIR") != '\0')
+    {
+      cache_dir = getenv ("PKG_CONFIG_CACHE_DIR");
+      disable_cache = FALSE;
+    }
+
+  /* Parse options */
+  opt_context = g_option_context_new (NULL);
+  g_option_context_add_main_entries (opt_context, options_table, NULL);
+  if (!g_option_context_parse(opt_context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return 1;
+    }
+
+  resolve_search_dirs ();
+
+  if (want_batch)
+    {
+      if (output_opt_set || argc > 1)
+        {
+          fprintf (stderr, "--batch reads queries from stdin and cannot be "
+                   "combined with output options or package names\n");
+          return 1;
+        }
+
+      return run_batch (open_log ());
+    }
+
+  if (want_build_index)
+    {
+      if (output_opt_set)
+        {
+          fprintf (stderr, "--build-index takes directories and cannot be "
+                   "combined with output options\n");
+          return 1;
+        }
+
+      return build_indexes (argc - 1, argv + 1);
+    }
+
+  setup_query ();
+
+  if (want_my_version)
+    {
+      printf ("%s\n", VERSION);
+      return 0;
+    }
+
+  if (required_pkgconfig_version)
+    {
+      if (compare_versions (VERSION, required_pkgconfig_version) >= 0)
+        return 0;
+      else
+        return 1;
+    }
+
+  package_init (want_list);
+
+  if (want_list)
+    {
+      print_package_list ();
+      return 0;
+    }
+
+  /* Collect packages from remaining args */
+  str = g_string_new ("");
+  while (argc > 1)
+    {
+      argc--;
+      argv++;
+
+      g_string_append (str, *argv);
+      g_string_append (str, " ");
+    }
+
+  g_option_context_free (opt_context);
+
+  g_strstrip (str->str);
+
+  log = open_log ();
+  status = run_query (str->str, log);
+
+  if (log != NULL)
+    fclose (log);
+
+  g_string_free (str, TRUE);
+
+  return status;
+}
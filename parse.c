@@ -24,15 +24,19 @@
 #endif
 
 #include "parse.h"
+#include "cache.h"
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
-#include <ctype.h>
 #ifdef HAVE_SYS_WAIT_H
 #include <sys/wait.h>
 #endif
 #include <sys/types.h>
+#include <sys/stat.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
 
 gboolean parse_strict = TRUE;
 gboolean define_prefix = ENABLE_DEFINE_PREFIX;
@@ -42,100 +46,169 @@ char *prefix_variable = "prefix";
 gboolean msvc_syntax = FALSE;
 #endif
 
+/* Classes of all byte values, so that the hot loops of the parser need a
+ * single table lookup per character.
+ */
+#define CHAR_SPACE     (1 << 0) /* isspace () in the C locale */
+#define CHAR_ESCAPE    (1 << 1) /* has to be escaped to pass a shell */
+#define CHAR_SEPARATOR (1 << 2) /* separates modules in Requires */
+
+#define E CHAR_ESCAPE
+#define C CHAR_SEPARATOR
+#define W (CHAR_SPACE | CHAR_ESCAPE | CHAR_SEPARATOR)
+
+static const guint8 char_classes[256] = {
+  E, E, E, E, E, E, E, E, E, W, W, W, W, W, E, E,
+  E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+  W, E, E, E, 0, E, E, E, 0, 0, E, 0, C, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, E, E, 0, E, E,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, E, E, E, 0, 0,
+  E, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, E, E, E, 0, E,
+  E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+  E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+  E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+  E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+  E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+  E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+  E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+  E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E
+};
+
+#undef E
+#undef C
+#undef W
+
+#define CHAR_IS(c, class) ((char_classes[(guchar)(c)] & (class)) != 0)
+#define IS_SPACE(c) CHAR_IS (c, CHAR_SPACE)
+
 /**
- * Read an entire line from a file into a buffer. Lines may
+ * Read an entire line from a buffer into a GString. Lines may
  * be delimited with '\n', '\r', '\n\r', or '\r\n'. The delimiter
  * is not written into the buffer. Text after a '#' character is treated as
  * a comment and skipped. '\' can be used to escape a # character.
  * '\' proceding a line delimiter combines adjacent lines. A '\' proceding
  * any other character is ignored and written into the output buffer
  * unmodified.
+ *
+ * The buffer is consumed from *cursor up to end, and *cursor is advanced
+ * past the line that was read. Runs of ordinary characters are located
+ * with memchr() and copied in bulk.
  * 
- * Return value: %FALSE if the stream was already at an EOF character.
+ * Return value: %FALSE if the buffer was already at its end.
  **/
 static gboolean
-read_one_line (FILE *stream, GString *str)
+read_one_line (const char **cursor, const char *end, GString *str)
 {
-  gboolean quoted = FALSE;
-  gboolean comment = FALSE;
-  int n_read = 0;
+  const char *p = *cursor;
 
   g_string_truncate (str, 0);
-  
+
+  if (p >= end)
+    return FALSE;
+
+  while (p < end)
+    {
+      const char *eol = memchr (p, '\n', end - p);
+      const char *stop = eol ? eol : end;
+      const char *q = p;
+
+      /* Copy everything up to the next comment or escape character */
+      while (q < stop && *q != '#' && *q != '\\')
+        q++;
+      g_string_append_len (str, p, q - p);
+
+      if (q < stop && *q == '\\')
+        {
+          q++;
+
+          if (q == end)
+            {
+              g_string_append_c (str, '\\');
+              p = end;
+              break;
+            }
+
+          switch (*q)
+            {
+            case '#':
+              g_string_append_c (str, '#');
+              p = q + 1;
+              break;
+            case '\r':
+            case '\n':
+              /* Line continuation; swallow a complete delimiter pair */
+              p = q + 1;
+              if (p < end &&
+                  ((*q == '\r' && *p == '\n') ||
+                   (*q == '\n' && *p == '\r')))
+                p++;
+              break;
+            default:
+              g_string_append_c (str, '\\');
+              g_string_append_c (str, *q);
+              p = q + 1;
+            }
+
+          continue;
+        }
+
+      /* Either a comment, which runs to the end of the line, or the end
+       * of the line itself. */
+      p = stop;
+      if (eol != NULL)
+        {
+          p++;
+          if (p < end && *p == '\r')
+            p++;
+        }
+      break;
+    }
+
+  *cursor = p;
+
+  return TRUE;
+}
+
+/* Load the complete contents of stream into a newly allocated,
+ * nul-terminated buffer so that lines can be split without going
+ * through stdio for every character.
+ */
+static char *
+read_file_contents (FILE *stream, gsize *length)
+{
+  struct stat st;
+  gsize size = 4096;
+  gsize len = 0;
+  char *data;
+
+  /* Size the buffer so a regular file is read in one go */
+  if (fstat (fileno (stream), &st) == 0 && st.st_size > 0)
+    size = st.st_size + 2;
+
+  data = g_malloc (size);
+
   while (1)
     {
-      int c;
-      
-      c = getc (stream);
+      size_t n;
 
-      if (c == EOF)
-	{
-	  if (quoted)
-	    g_string_append_c (str, '\\');
-	  
-	  goto done;
-	}
-      else
-	n_read++;
+      if (len + 1 >= size)
+        {
+          size *= 2;
+          data = g_realloc (data, size);
+        }
 
-      if (quoted)
-	{
-	  quoted = FALSE;
-	  
-	  switch (c)
-	    {
-	    case '#':
-	      g_string_append_c (str, '#');
-	      break;
-	    case '\r':
-	    case '\n':
-	      {
-		int next_c = getc (stream);
-
-		if (!(c == EOF ||
-		      (c == '\r' && next_c == '\n') ||
-		      (c == '\n' && next_c == '\r')))
-		  ungetc (next_c, stream);
-		
-		break;
-	      }
-	    default:
-	      g_string_append_c (str, '\\');	      
-	      g_string_append_c (str, c);
-	    }
-	}
-      else
-	{
-	  switch (c)
-	    {
-	    case '#':
-	      comment = TRUE;
-	      break;
-	    case '\\':
-	      if (!comment)
-		quoted = TRUE;
-	      break;
-	    case '\n':
-	      {
-		int next_c = getc (stream);
-
-		if (!(c == EOF ||
-		      (c == '\r' && next_c == '\n') ||
-		      (c == '\n' && next_c == '\r')))
-		  ungetc (next_c, stream);
-
-		goto done;
-	      }
-	    default:
-	      if (!comment)
-		g_string_append_c (str, c);
-	    }
-	}
+      n = fread (data + len, 1, size - len - 1, stream);
+      if (n == 0)
+        break;
+      len += n;
     }
 
- done:
+  data[len] = '\0';
+  *length = len;
 
-  return n_read > 0;
+  return data;
 }
 
 static char *
@@ -145,83 +218,221 @@ trim_string (const char *str)
 
   g_return_val_if_fail (str != NULL, NULL);
   
-  while (*str && isspace ((guchar)*str))
+  while (*str && IS_SPACE (*str))
     str++;
 
   len = strlen (str);
-  while (len > 0 && isspace ((guchar)str[len-1]))
+  while (len > 0 && IS_SPACE (str[len-1]))
     len--;
 
   return g_strndup (str, len);
 }
 
-static char *
-trim_and_sub (Package *pkg, const char *str, const char *path)
+/* Names of the variables looked up while parsing the current file, which
+ * the compiled package cache has to check before reusing it. Files may
+ * be parsed by several threads at once, so each has its own.
+ */
+static GPrivate parse_lookups = G_PRIVATE_INIT (NULL);
+
+/* Look up the variable named by the LEN bytes at NAME. When REPORT is
+ * set, record the lookup for the cache and complain if it is undefined.
+ */
+static const char *
+lookup_var_ref (Package *pkg, const char *name, gsize len, gboolean report,
+                const char *path)
 {
-  char *trimmed;
-  GString *subst;
-  char *p;
-  
-  trimmed = trim_string (str);
+  char buf[64];
+  char *varname;
+  const char *varval;
 
-  subst = g_string_new ("");
+  varname = len < sizeof (buf) ? buf : g_malloc (len + 1);
+  memcpy (varname, name, len);
+  varname[len] = '\0';
 
-  p = trimmed;
-  while (*p)
+  varval = package_peek_var (pkg, varname);
+
+  if (report)
     {
-      if (p[0] == '$' &&
-          p[1] == '$')
+      GHashTable *lookups = g_private_get (&parse_lookups);
+
+      if (lookups != NULL &&
+          g_hash_table_lookup (lookups, varname) == NULL)
+        g_hash_table_insert (lookups, g_strdup (varname),
+                             GINT_TO_POINTER (TRUE));
+
+      if (varval == NULL)
+        {
+          verbose_error ("Variable '%s' not defined in '%s'\n",
+                         varname, path);
+          if (parse_strict)
+            fatal_error ();
+        }
+    }
+
+  if (varname != buf)
+    g_free (varname);
+
+  return varval;
+}
+
+/* The values of the first few references are kept between the two passes
+ * of trim_and_sub(), so that most are only looked up once.
+ */
+#define MAX_KEPT_REFS 16
+
+/* Substitute the variables in the span from STR to END into DEST, which
+ * is only measured when DEST is NULL. Errors are reported while
+ * measuring.
+ */
+static gsize
+substitute_vars (Package *pkg, const char *str, const char *end,
+                 char *dest, const char **kept, const char *path)
+{
+  const char *p = str;
+  gsize len = 0;
+  guint refs = 0;
+
+  while (p < end)
+    {
+      const char *run = p;
+      const char *name;
+      const char *varval;
+
+      /* Copy everything up to the next '$' in one go */
+      p = memchr (p, '$', end - p);
+      if (p == NULL)
+        p = end;
+      if (dest != NULL)
+        memcpy (dest + len, run, p - run);
+      len += p - run;
+
+      if (p == end)
+        break;
+
+      if (p + 1 == end || (p[1] != '$' && p[1] != '{'))
+        {
+          if (dest != NULL)
+            dest[len] = '$';
+          len++;
+          p++;
+          continue;
+        }
+      else if (p[1] == '$')
         {
           /* escaped $ */
-          g_string_append_c (subst, '$');
+          if (dest != NULL)
+            dest[len] = '$';
+          len++;
           p += 2;
+          continue;
         }
-      else if (p[0] == '$' &&
-               p[1] == '{')
-        {
-          /* variable */
-          char *var_start;
-          char *varname;
-          char *varval;
-          
-          var_start = &p[2];
-
-          /* Get up to close brace. */
-          while (*p && *p != '}')
-            ++p;
-
-          varname = g_strndup (var_start, p - var_start);
-
-          ++p; /* past brace */
-          
-          varval = package_get_var (pkg, varname);
-          
-          if (varval == NULL)
-            {
-              verbose_error ("Variable '%s' not defined in '%s'\n",
-                             varname, path);
-              if (parse_strict)
-                exit (1);
-            }
 
-          g_free (varname);
+      /* variable, up to the close brace */
+      name = p + 2;
+      p = memchr (name, '}', end - name);
+      if (p == NULL)
+        p = end;
 
-          g_string_append (subst, varval);
-          g_free (varval);
+      if (dest == NULL)
+        {
+          varval = lookup_var_ref (pkg, name, p - name, TRUE, path);
+          if (refs < MAX_KEPT_REFS)
+            kept[refs] = varval;
         }
+      else if (refs < MAX_KEPT_REFS)
+        varval = kept[refs];
       else
+        varval = lookup_var_ref (pkg, name, p - name, FALSE, path);
+      refs++;
+
+      if (p < end)
+        p++; /* past brace */
+
+      if (varval != NULL)
         {
-          g_string_append_c (subst, *p);
+          gsize n = strlen (varval);
 
-          ++p;          
+          if (dest != NULL)
+            memcpy (dest + len, varval, n);
+          len += n;
         }
     }
 
-  g_free (trimmed);
-  p = subst->str;
-  g_string_free (subst, FALSE);
+  return len;
+}
+
+/* Trim STR and substitute the variables in it, sizing the result in a
+ * first pass so that it is allocated only once.
+ */
+static char *
+trim_and_sub (Package *pkg, const char *str, const char *path)
+{
+  const char *kept[MAX_KEPT_REFS];
+  const char *end;
+  char *result;
+  gsize len;
+
+  while (*str && IS_SPACE (*str))
+    str++;
+
+  end = str + strlen (str);
+  while (end > str && IS_SPACE (end[-1]))
+    end--;
 
-  return p;
+  len = substitute_vars (pkg, str, end, NULL, kept, path);
+  result = g_malloc (len + 1);
+  substitute_vars (pkg, str, end, result, kept, path);
+  result[len] = '\0';
+
+  return result;
+}
+
+/* Whether all the variables STR refers to are defined already, in which
+ * case expanding it later gives the same result as expanding it now.
+ * The variables are recorded as looked up either way.
+ */
+static gboolean
+var_references_defined (Package *pkg, const char *str)
+{
+  GHashTable *lookups = g_private_get (&parse_lookups);
+  const char *p = str;
+
+  while ((p = strchr (p, '$')) != NULL)
+    {
+      const char *end;
+      char *varname;
+      gboolean defined;
+
+      if (p[1] == '$')
+        {
+          p += 2;
+          continue;
+        }
+      else if (p[1] != '{')
+        {
+          p++;
+          continue;
+        }
+
+      end = strchr (p + 2, '}');
+      if (end == NULL)
+        return FALSE;
+
+      varname = g_strndup (p + 2, end - (p + 2));
+      defined = package_has_var (pkg, varname);
+      if (defined && lookups != NULL &&
+          g_hash_table_lookup (lookups, varname) == NULL)
+        g_hash_table_insert (lookups, varname, GINT_TO_POINTER (TRUE));
+      else
+        g_free (varname);
+
+      if (!defined)
+        return FALSE;
+
+      p = end + 1;
+    }
+
+  return TRUE;
 }
 
 static void
@@ -231,7 +442,7 @@ parse_name (Package *pkg, const char *str, const char *path)
     {
       verbose_error ("Name field occurs twice in '%s'\n", path);
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         return;
     }
@@ -246,7 +457,7 @@ parse_version (Package *pkg, const char *str, const char *path)
     {
       verbose_error ("Version field occurs twice in '%s'\n", path);
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         return;
     }
@@ -261,7 +472,7 @@ parse_description (Package *pkg, const char *str, const char *path)
     {
       verbose_error ("Description field occurs twice in '%s'\n", path);
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         return;
     }
@@ -270,7 +481,7 @@ parse_description (Package *pkg, const char *str, const char *path)
 }
 
 
-#define MODULE_SEPARATOR(c) ((c) == ',' || isspace ((guchar)(c)))
+#define MODULE_SEPARATOR(c) CHAR_IS (c, CHAR_SEPARATOR)
 #define OPERATOR_CHAR(c) ((c) == '<' || (c) == '>' || (c) == '!' || (c) == '=')
 
 /* A module list is a list of modules with optional version specification,
@@ -279,235 +490,129 @@ parse_description (Package *pkg, const char *str, const char *path)
  * where @FRIBIDI_PC@ gets substituted to nothing or to 'fribidi'
  */
 
-typedef enum
+/* The version comparison operators, as written in a module list */
+static const struct
 {
-  /* put numbers to help interpret lame debug spew ;-) */
-  OUTSIDE_MODULE = 0,
-  IN_MODULE_NAME = 1,
-  BEFORE_OPERATOR = 2,
-  IN_OPERATOR = 3,
-  AFTER_OPERATOR = 4,
-  IN_MODULE_VERSION = 5  
-} ModuleSplitState;
-
-#define PARSE_SPEW 0
-
-static GList *
-split_module_list (const char *str, const char *path)
-{
-  GList *retval = NULL;
-  const char *p;
-  const char *start;
-  ModuleSplitState state = OUTSIDE_MODULE;
-  ModuleSplitState last_state = OUTSIDE_MODULE;
+  const char *op;
+  gsize len;
+  ComparisonType comparison;
+} comparisons[] = {
+  { "=", 1, EQUAL },
+  { ">=", 2, GREATER_THAN_EQUAL },
+  { "<=", 2, LESS_THAN_EQUAL },
+  { ">", 1, GREATER_THAN },
+  { "<", 1, LESS_THAN },
+  { "!=", 2, NOT_EQUAL },
+};
 
-  /*   fprintf (stderr, "Parsing: '%s'\n", str); */
-  
-  start = str;
-  p = str;
-
-  while (*p)
-    {
-#if PARSE_SPEW
-      fprintf (stderr, "p: %c state: %d last_state: %d\n", *p, state, last_state);
-#endif
-      
-      switch (state)
-        {
-        case OUTSIDE_MODULE:
-          if (!MODULE_SEPARATOR (*p))
-            state = IN_MODULE_NAME;          
-          break;
-
-        case IN_MODULE_NAME:
-          if (isspace ((guchar)*p))
-            {
-              /* Need to look ahead to determine next state */
-              const char *s = p;
-              while (*s && isspace ((guchar)*s))
-                ++s;
-
-              if (*s == '\0')
-                state = OUTSIDE_MODULE;
-              else if (MODULE_SEPARATOR (*s))
-                state = OUTSIDE_MODULE;
-              else if (OPERATOR_CHAR (*s))
-                state = BEFORE_OPERATOR;
-              else
-                state = OUTSIDE_MODULE;
-            }
-          else if (MODULE_SEPARATOR (*p))
-            state = OUTSIDE_MODULE; /* comma precludes any operators */
-          break;
-
-        case BEFORE_OPERATOR:
-          /* We know an operator is coming up here due to lookahead from
-           * IN_MODULE_NAME
-           */
-          if (isspace ((guchar)*p))
-            ; /* no change */
-          else if (OPERATOR_CHAR (*p))
-            state = IN_OPERATOR;
-          else
-            g_assert_not_reached ();
-          break;
-
-        case IN_OPERATOR:
-          if (!OPERATOR_CHAR (*p))
-            state = AFTER_OPERATOR;
-          break;
-
-        case AFTER_OPERATOR:
-          if (!isspace ((guchar)*p))
-            state = IN_MODULE_VERSION;
-          break;
-
-        case IN_MODULE_VERSION:
-          if (MODULE_SEPARATOR (*p))
-            state = OUTSIDE_MODULE;
-          break;
-          
-        default:
-          g_assert_not_reached ();
-        }
-
-      if (state == OUTSIDE_MODULE &&
-          last_state != OUTSIDE_MODULE)
-        {
-          /* We left a module */
-          char *module = g_strndup (start, p - start);
-          retval = g_list_prepend (retval, module);
-
-#if PARSE_SPEW
-          fprintf (stderr, "found module: '%s'\n", module);
-#endif
-          
-          /* reset start */
-          start = p;
-        }
-      
-      last_state = state;
-      ++p;
-    }
+static gboolean
+lookup_comparison (const char *op, gsize len, ComparisonType *comparison)
+{
+  gsize i;
 
-  if (p != start)
-    {
-      /* get the last module */
-      char *module = g_strndup (start, p - start);
-      retval = g_list_prepend (retval, module);
+  for (i = 0; i < G_N_ELEMENTS (comparisons); i++)
+    if (comparisons[i].len == len && memcmp (comparisons[i].op, op, len) == 0)
+      {
+        *comparison = comparisons[i].comparison;
+        return TRUE;
+      }
 
-#if PARSE_SPEW
-      fprintf (stderr, "found module: '%s'\n", module);
-#endif
-      
-    }
-  
-  retval = g_list_reverse (retval);
-
-  return retval;
+  return FALSE;
 }
 
+/* Scan the module list in STR in a single pass, copying only the names
+ * and versions out of it. A module is a name, optionally followed by
+ * whitespace, an operator and a version. The character right after the
+ * operator and the first one that is not whitespace after it belong to
+ * the module even if they are commas; the module then ends at the next
+ * separator.
+ */
 GList *
 parse_module_list (Package *pkg, const char *str, const char *path)
 {
-  GList *split;
-  GList *iter;
   GList *retval = NULL;
+  const char *p = str;
 
-  split = split_module_list (str, path);
-
-  for (iter = split; iter != NULL; iter = g_list_next (iter))
+  while (*p)
     {
       RequiredVersion *ver;
-      char *p;
-      char *start;
-      
-      p = iter->data;
+      const char *start;
+      const char *op;
+      const char *op_end;
+      const char *end;
+
+      while (*p && MODULE_SEPARATOR (*p))
+        ++p;
 
       ver = g_new0 (RequiredVersion, 1);
       ver->comparison = ALWAYS_MATCH;
       ver->owner = pkg;
       retval = g_list_prepend (retval, ver);
-      
-      while (*p && MODULE_SEPARATOR (*p))
-        ++p;
-      
-      start = p;
-
-      while (*p && !isspace ((guchar)*p))
-        ++p;
-
-      while (*p && MODULE_SEPARATOR (*p))
-        {
-          *p = '\0';
-          ++p;
-        }
 
-      if (*start == '\0')
+      if (*p == '\0')
         {
           verbose_error ("Empty package name in Requires or Conflicts in file '%s'\n", path);
           if (parse_strict)
-            exit (1);
+            fatal_error ();
           else
-            continue;
+            break;
         }
-      
-      ver->name = g_strdup (start);
 
       start = p;
-
-      while (*p && !isspace ((guchar)*p))
+      while (*p && !MODULE_SEPARATOR (*p))
         ++p;
+      ver->name = g_strndup (start, p - start);
 
-      while (*p && isspace ((guchar)*p))
-        {
-          *p = '\0';
-          ++p;
-        }
-      
-      if (*start != '\0')
-        {
-          if (strcmp (start, "=") == 0)
-            ver->comparison = EQUAL;
-          else if (strcmp (start, ">=") == 0)
-            ver->comparison = GREATER_THAN_EQUAL;
-          else if (strcmp (start, "<=") == 0)
-            ver->comparison = LESS_THAN_EQUAL;
-          else if (strcmp (start, ">") == 0)
-            ver->comparison = GREATER_THAN;
-          else if (strcmp (start, "<") == 0)
-            ver->comparison = LESS_THAN;
-          else if (strcmp (start, "!=") == 0)
-            ver->comparison = NOT_EQUAL;
-          else
-            {
-              verbose_error ("Unknown version comparison operator '%s' after "
-                             "package name '%s' in file '%s'\n", start,
-                             ver->name, path);
-              if (parse_strict)
-                exit (1);
-              else
-                continue;
-            }
-        }
+      /* Only whitespace followed by an operator continues the module */
+      op = p;
+      while (IS_SPACE (*op))
+        ++op;
+      if (op == p || !OPERATOR_CHAR (*op))
+        continue;
 
-      start = p;
-      
+      p = op;
+      while (OPERATOR_CHAR (*p))
+        ++p;
+      if (*p)
+        ++p;
+      while (IS_SPACE (*p))
+        ++p;
+      if (*p)
+        ++p;
       while (*p && !MODULE_SEPARATOR (*p))
         ++p;
+      end = p;
 
-      while (*p && MODULE_SEPARATOR (*p))
+      /* The operator runs up to the next whitespace, so anything glued
+       * to it makes it unknown */
+      op_end = op;
+      while (op_end < end && !IS_SPACE (*op_end))
+        ++op_end;
+
+      if (!lookup_comparison (op, op_end - op, &ver->comparison))
         {
-          *p = '\0';
-          ++p;
+          verbose_error ("Unknown version comparison operator '%.*s' after "
+                         "package name '%s' in file '%s'\n",
+                         (int) (op_end - op), op, ver->name, path);
+          if (parse_strict)
+            fatal_error ();
+          else
+            continue;
         }
-      
-      if (ver->comparison != ALWAYS_MATCH && *start == '\0')
+
+      start = op_end;
+      while (start < end && IS_SPACE (*start))
+        ++start;
+      op_end = start;
+      while (op_end < end && !MODULE_SEPARATOR (*op_end))
+        ++op_end;
+
+      if (op_end == start)
         {
           verbose_error ("Comparison operator but no version after package "
                          "name '%s' in file '%s'\n", ver->name, path);
           if (parse_strict)
-            exit (1);
+            fatal_error ();
           else
             {
               ver->version = g_strdup ("0");
@@ -515,17 +620,9 @@ parse_module_list (Package *pkg, const char *str, const char *path)
             }
         }
 
-      if (*start != '\0')
-        {
-          ver->version = g_strdup (start);
-        }
-
-      g_assert (ver->name);
+      ver->version = g_strndup (start, op_end - start);
     }
 
-  g_list_foreach (split, (GFunc) g_free, NULL);
-  g_list_free (split);
-
   retval = g_list_reverse (retval);
 
   return retval;
@@ -540,7 +637,7 @@ parse_requires (Package *pkg, const char *str, const char *path)
     {
       verbose_error ("Requires field occurs twice in '%s'\n", path);
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         return;
     }
@@ -559,7 +656,7 @@ parse_requires_private (Package *pkg, const char *str, const char *path)
     {
       verbose_error ("Requires.private field occurs twice in '%s'\n", path);
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         return;
     }
@@ -578,7 +675,7 @@ parse_conflicts (Package *pkg, const char *str, const char *path)
     {
       verbose_error ("Conflicts field occurs twice in '%s'\n", path);
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         return;
     }
@@ -588,38 +685,214 @@ parse_conflicts (Package *pkg, const char *str, const char *path)
   g_free (trimmed);
 }
 
-static char *strdup_escape_shell(const char *s)
+/* Escape the characters of S that a shell would interpret, sizing the
+ * result exactly.
+ */
+static char *
+strdup_escape_shell (const char *s)
 {
-	size_t r_s = strlen(s)+10, c = 0;
-	char *r = g_malloc(r_s);
-	while (s[0]) {
-		if ((s[0] < '$') ||
-		    (s[0] > '$' && s[0] < '(') ||
-		    (s[0] > ')' && s[0] < '+') ||
-		    (s[0] > ':' && s[0] < '=') ||
-		    (s[0] > '=' && s[0] < '@') ||
-		    (s[0] > 'Z' && s[0] < '^') ||
-		    (s[0] == '`') ||
-		    (s[0] > 'z' && s[0] < '~') ||
-		    (s[0] > '~')) {
-			r[c] = '\\';
-			c++;
-		}
-		r[c] = *s;
-		c++;
-		if (c+2 >= r_s) {
-			r_s *= 2;
-			r = g_realloc(r, r_s);
-		}
-		s++;
-	}
-	r[c] = 0;
-	return r;
+  const char *p;
+  char *r;
+  char *q;
+  gsize len = 0;
+
+  for (p = s; *p != '\0'; p++)
+    len += CHAR_IS (*p, CHAR_ESCAPE) ? 2 : 1;
+
+  r = q = g_malloc (len + 1);
+  for (p = s; *p != '\0'; p++)
+    {
+      if (CHAR_IS (*p, CHAR_ESCAPE))
+        *q++ = '\\';
+      *q++ = *p;
+    }
+  *q = '\0';
+
+  return r;
+}
+
+/* Append the LEN bytes at S to STR escaped as by strdup_escape_shell (). */
+void
+append_escape_shell (GString *str, const char *s, gsize len)
+{
+  const char *end = s + len;
+  const char *run;
+
+  while (s < end)
+    {
+      for (run = s; s < end && !CHAR_IS (*s, CHAR_ESCAPE); s++)
+        ;
+      g_string_append_len (str, run, s - run);
+
+      if (s < end)
+        {
+          g_string_append_c (str, '\\');
+          g_string_append_c (str, *s);
+          s++;
+        }
+    }
+}
+
+/* Strip leading and trailing whitespace without copying STR. */
+static char *
+trim_string_in_place (char *str)
+{
+  char *end;
+
+  while (*str && IS_SPACE (*str))
+    str++;
+
+  end = str + strlen (str);
+  while (end > str && IS_SPACE (end[-1]))
+    end--;
+  *end = '\0';
+
+  return str;
 }
 
-static void _do_parse_libs (Package *pkg, int argc, char **argv)
+/* Split STR into arguments the way g_shell_parse_argv () does, in a
+ * single pass. The unquoted arguments are written to BUF, which must have
+ * room for strlen (STR) + 1 bytes, and added to ARGS. Returns FALSE if
+ * g_shell_parse_argv () would fail on STR.
+ */
+static gboolean
+split_args (const char *str, char *buf, GPtrArray *args)
 {
+  const char *p;
+  char *out = buf;
+  char *token = NULL;
+
+  for (p = str; *p != '\0'; p++)
+    {
+      switch (*p)
+        {
+        case ' ':
+        case '\t':
+        case '\n':
+          if (token != NULL)
+            {
+              *out++ = '\0';
+              g_ptr_array_add (args, token);
+              token = NULL;
+            }
+          break;
+
+        case '\\':
+          /* Anything can be escaped, a newline just disappears */
+          if (*++p == '\0')
+            return FALSE;
+          if (*p != '\n')
+            {
+              if (token == NULL)
+                token = out;
+              *out++ = *p;
+            }
+          break;
+
+        case '\'':
+          if (token == NULL)
+            token = out;
+          for (p++; *p != '\'' && *p != '\0'; p++)
+            *out++ = *p;
+          if (*p == '\0')
+            return FALSE;
+          break;
+
+        case '"':
+          if (token == NULL)
+            token = out;
+          for (p++; *p != '"' && *p != '\0'; p++)
+            {
+              /* Only these are escaped within double quotes */
+              if (*p == '\\' && p[1] != '\0' && strchr ("\"\\`$\n", p[1]))
+                p++;
+              *out++ = *p;
+            }
+          if (*p == '\0')
+            return FALSE;
+          break;
+
+        case '#':
+          /* A comment only starts at the beginning of a word, and runs
+           * to the end of the line, which does not end the argument.
+           */
+          if (p == str || p[-1] == ' ' || p[-1] == '\n')
+            {
+              if (*++p == '\0')
+                return FALSE;
+              while (*p != '\n' && *p != '\0')
+                p++;
+              if (*p == '\0')
+                p--;
+              break;
+            }
+          /* fall through */
+
+        default:
+          if (token == NULL)
+            token = out;
+          *out++ = *p;
+          break;
+        }
+    }
+
+  if (token != NULL)
+    {
+      *out = '\0';
+      g_ptr_array_add (args, token);
+    }
+
+  return args->len > 0;
+}
+
+/* Split the expanded value STR of FIELD into ARGS, pointing into the
+ * returned buffer, or report why it cannot be split and return NULL.
+ */
+static char *
+split_flags (const char *str, const char *field, GPtrArray *args)
+{
+  GError *error = NULL;
+  char **argv = NULL;
+  char *buf;
+  gsize len;
+  int argc;
   int i;
+
+  buf = g_malloc (strlen (str) + 1);
+  if (split_args (str, buf, args))
+    return buf;
+
+  /* Leave explaining what is wrong to glib. Should it have no
+   * complaints after all, go with its arguments.
+   */
+  g_free (buf);
+  g_ptr_array_set_size (args, 0);
+  if (!g_shell_parse_argv (str, &argc, &argv, &error))
+    {
+      verbose_error ("Couldn't parse %s field into an argument vector: %s\n",
+                     field, error ? error->message : "unknown");
+      g_clear_error (&error);
+      return NULL;
+    }
+
+  for (i = 0, len = 0; i < argc; i++)
+    len += strlen (argv[i]) + 1;
+  buf = g_malloc (len);
+  for (i = 0, len = 0; i < argc; i++)
+    {
+      strcpy (buf + len, argv[i]);
+      g_ptr_array_add (args, buf + len);
+      len += strlen (argv[i]) + 1;
+    }
+  g_strfreev (argv);
+
+  return buf;
+}
+
+static void _do_parse_libs (GList **libs, GPtrArray *args)
+{
+  GString *arg = g_string_new (NULL);
+  guint i;
 #ifdef G_OS_WIN32
   char *L_flag = (msvc_syntax ? "/libpath:" : "-L");
   char *l_flag = (msvc_syntax ? "" : "-l");
@@ -630,15 +903,14 @@ static void _do_parse_libs (Package *pkg, int argc, char **argv)
   char *lib_suffix = "";
 #endif
 
-  i = 0;
-  while (i < argc)
+  for (i = 0; i < args->len; i++)
     {
-      Flag *flag = g_new (Flag, 1);
-      char *tmp = trim_string (argv[i]);
-      char *arg = strdup_escape_shell(tmp);
-      char *p;
-      p = arg;
-      g_free(tmp);
+      char *p = trim_string_in_place (g_ptr_array_index (args, i));
+      FlagType type;
+      gsize join = 0;
+      Flag *flag;
+
+      g_string_truncate (arg, 0);
 
       if (p[0] == '-' &&
           p[1] == 'l' &&
@@ -646,59 +918,50 @@ static void _do_parse_libs (Package *pkg, int argc, char **argv)
               flag. */
 	  (strncmp(p, "-lib:", 5) != 0))
         {
-          p += 2;
-          while (*p && isspace ((guchar)*p))
-            ++p;
-
-          flag->type = LIBS_l;
-          flag->arg = g_strconcat (l_flag, p, lib_suffix, NULL);
-          pkg->libs = g_list_prepend (pkg->libs, flag);
+          type = LIBS_l;
+          g_string_append (arg, l_flag);
+          g_string_append (arg, p + 2);
+          g_string_append (arg, lib_suffix);
         }
       else if (p[0] == '-' &&
                p[1] == 'L')
         {
-          p += 2;
-          while (*p && isspace ((guchar)*p))
-            ++p;
-
-          flag->type = LIBS_L;
-          flag->arg = g_strconcat (L_flag, p, NULL);
-          pkg->libs = g_list_prepend (pkg->libs, flag);
+          type = LIBS_L;
+          g_string_append (arg, L_flag);
+          g_string_append (arg, p + 2);
 	}
       else if ((strcmp("-framework", p) == 0 ||
                 strcmp("-Wl,-framework", p) == 0) &&
-               i+1 < argc)
+               i+1 < args->len)
         {
           /* Mac OS X has a -framework Foo which is really one option,
            * so we join those to avoid having -framework Foo
            * -framework Bar being changed into -framework Foo Bar
            * later
           */
-          gchar *framework, *tmp = trim_string (argv[i+1]);
-
-          framework = strdup_escape_shell(tmp);
-          flag->type = LIBS_OTHER;
-          flag->arg = g_strconcat (arg, " ", framework, NULL);
-          pkg->libs = g_list_prepend (pkg->libs, flag);
+          type = LIBS_OTHER;
+          g_string_append (arg, p);
+          join = arg->len;
+          g_string_append_c (arg, ' ');
           i++;
-          g_free (framework);
-          g_free (tmp);
+          g_string_append (arg,
+                           trim_string_in_place (g_ptr_array_index (args, i)));
         }
-      else if (*arg != '\0')
+      else if (*p != '\0')
         {
-          flag->type = LIBS_OTHER;
-          flag->arg = g_strdup (arg);
-          pkg->libs = g_list_prepend (pkg->libs, flag);
+          type = LIBS_OTHER;
+          g_string_append (arg, p);
         }
       else
         /* flag wasn't used */
-        g_free (flag);
-
-      g_free (arg);
+        continue;
 
-      ++i;
+      flag = flag_new (type, arg->str, arg->len);
+      flag->join = join;
+      *libs = g_list_prepend (*libs, flag);
     }
 
+  g_string_free (arg, TRUE);
 }
 
 
@@ -708,44 +971,60 @@ parse_libs (Package *pkg, const char *str, const char *path)
   /* Strip out -l and -L flags, put them in a separate list. */
   
   char *trimmed;
-  char **argv = NULL;
-  int argc = 0;
-  GError *error = NULL;
+  char *buf = NULL;
+  GPtrArray *args;
   
   if (pkg->libs_num > 0)
     {
       verbose_error ("Libs field occurs twice in '%s'\n", path);
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         return;
     }
   
   trimmed = trim_and_sub (pkg, str, path);
+  args = g_ptr_array_new ();
 
   if (trimmed && *trimmed &&
-      !g_shell_parse_argv (trimmed, &argc, &argv, &error))
+      (buf = split_flags (trimmed, "Libs", args)) == NULL)
     {
-      verbose_error ("Couldn't parse Libs field into an argument vector: %s\n",
-                     error ? error->message : "unknown");
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         {
+          g_ptr_array_free (args, TRUE);
           g_free (trimmed);
           return;
         }
     }
 
-  _do_parse_libs(pkg, argc, argv);
+  _do_parse_libs (&pkg->libs, args);
 
   g_free (trimmed);
-  g_strfreev (argv);
+  g_free (buf);
+  g_ptr_array_free (args, TRUE);
   pkg->libs_num++;
 }
 
+/* Libs.private is only split when a static link needs it, so that a
+ * broken one does not fail the dynamic queries. Keep it as written.
+ */
 static void
 parse_libs_private (Package *pkg, const char *str, const char *path)
+{
+  if (pkg->libs_private_num == 0)
+    {
+      pkg->libs_private_field = g_strdup (str);
+      if (pkg->libs_num == 0)
+        pkg->libs_private_first = TRUE;
+    }
+
+  pkg->libs_private_num++;
+}
+
+void
+parse_package_libs_private (Package *pkg)
 {
   /*
     List of private libraries.  Private libraries are libraries which
@@ -759,42 +1038,47 @@ parse_libs_private (Package *pkg, const char *str, const char *path)
     a public dependency and not a private one.
   */
   
+  char *field = pkg->libs_private_field;
   char *trimmed;
-  char **argv = NULL;
-  int argc = 0;
-  GError *error = NULL;
-  
-  if (pkg->libs_private_num > 0)
+  char *buf = NULL;
+  GPtrArray *args;
+
+  if (field == NULL)
+    return;
+  pkg->libs_private_field = NULL;
+
+  if (pkg->libs_private_num > 1)
     {
-      verbose_error ("Libs.private field occurs twice in '%s'\n", path);
+      verbose_error ("Libs.private field occurs twice in '%s'\n", pkg->path);
       if (parse_strict)
-        exit (1);
-      else
-        return;
+        fatal_error ();
     }
   
-  trimmed = trim_and_sub (pkg, str, path);
+  trimmed = trim_and_sub (pkg, field, pkg->path);
+  g_free (field);
+  args = g_ptr_array_new ();
 
   if (trimmed && *trimmed &&
-      !g_shell_parse_argv (trimmed, &argc, &argv, &error))
+      (buf = split_flags (trimmed, "Libs.private", args)) == NULL)
     {
-      verbose_error ("Couldn't parse Libs.private field into an argument vector: %s\n",
-                     error ? error->message : "unknown");
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         {
+          g_ptr_array_free (args, TRUE);
           g_free (trimmed);
           return;
         }
     }
 
-  _do_parse_libs(pkg, argc, argv);
+  /* Kept apart so that the same package can answer both static and
+   * dynamic queries */
+  _do_parse_libs (&pkg->libs_private, args);
+  pkg->libs_private = g_list_reverse (pkg->libs_private);
 
-  g_strfreev (argv);
+  g_free (buf);
+  g_ptr_array_free (args, TRUE);
   g_free (trimmed);
-
-  pkg->libs_private_num++;
 }
 
 static void
@@ -803,89 +1087,83 @@ parse_cflags (Package *pkg, const char *str, const char *path)
   /* Strip out -I flags, put them in a separate list. */
   
   char *trimmed;
-  char **argv = NULL;
-  int argc = 0;
-  GError *error = NULL;
-  int i;
+  char *buf = NULL;
+  GPtrArray *args;
+  GString *arg;
+  guint i;
   
   if (pkg->cflags)
     {
       verbose_error ("Cflags field occurs twice in '%s'\n", path);
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         return;
     }
   
   trimmed = trim_and_sub (pkg, str, path);
+  args = g_ptr_array_new ();
 
   if (trimmed && *trimmed &&
-      !g_shell_parse_argv (trimmed, &argc, &argv, &error))
+      (buf = split_flags (trimmed, "Cflags", args)) == NULL)
     {
-      verbose_error ("Couldn't parse Cflags field into an argument vector: %s\n",
-                     error ? error->message : "unknown");
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         {
+          g_ptr_array_free (args, TRUE);
           g_free (trimmed);
           return;
         }
     }
 
-  i = 0;
-  while (i < argc)
+  arg = g_string_new (NULL);
+  for (i = 0; i < args->len; i++)
     {
-      Flag *flag = g_new (Flag, 1);
-      char *tmp = trim_string (argv[i]);
-      char *arg = strdup_escape_shell(tmp);
-      char *p = arg;
-      g_free(tmp);
+      char *p = trim_string_in_place (g_ptr_array_index (args, i));
+      FlagType type;
+      gsize join = 0;
+      Flag *flag;
+
+      g_string_truncate (arg, 0);
 
       if (p[0] == '-' &&
           p[1] == 'I')
         {
-          p += 2;
-          while (*p && isspace ((guchar)*p))
-            ++p;
-
-          flag->type = CFLAGS_I;
-          flag->arg = g_strconcat ("-I", p, NULL);
-          pkg->cflags = g_list_prepend (pkg->cflags, flag);
+          type = CFLAGS_I;
+          g_string_append (arg, "-I");
+          g_string_append (arg, p + 2);
         }
-      else if ((strcmp ("-idirafter", arg) == 0 ||
-                strcmp ("-isystem", arg) == 0) &&
-               i+1 < argc)
+      else if ((strcmp ("-idirafter", p) == 0 ||
+                strcmp ("-isystem", p) == 0) &&
+               i+1 < args->len)
         {
-          char *option, *tmp;
-
-          tmp = trim_string (argv[i+1]);
-          option = strdup_escape_shell (tmp);
-
           /* These are -I flags since they control the search path */
-          flag->type = CFLAGS_I;
-          flag->arg = g_strconcat (arg, " ", option, NULL);
-          pkg->cflags = g_list_prepend (pkg->cflags, flag);
+          type = CFLAGS_I;
+          g_string_append (arg, p);
+          join = arg->len;
+          g_string_append_c (arg, ' ');
           i++;
-          g_free (option);
-          g_free (tmp);
+          g_string_append (arg,
+                           trim_string_in_place (g_ptr_array_index (args, i)));
         }
-      else if (*arg != '\0')
+      else if (*p != '\0')
         {
-          flag->type = CFLAGS_OTHER;
-          flag->arg = g_strdup (arg);
-          pkg->cflags = g_list_prepend (pkg->cflags, flag);
+          type = CFLAGS_OTHER;
+          g_string_append (arg, p);
         }
       else
         /* flag wasn't used */
-        g_free (flag);
+        continue;
 
-      g_free (arg);
-      
-      ++i;
+      flag = flag_new (type, arg->str, arg->len);
+      flag->join = join;
+      pkg->cflags = g_list_prepend (pkg->cflags, flag);
     }
 
-  g_strfreev (argv);
+  g_string_free (arg, TRUE);
+  g_free (buf);
+  g_ptr_array_free (args, TRUE);
   g_free (trimmed);
 }
 
@@ -896,7 +1174,7 @@ parse_url (Package *pkg, const char *str, const char *path)
     {
       verbose_error ("URL field occurs twice in '%s'\n", path);
       if (parse_strict)
-        exit (1);
+        fatal_error ();
       else
         return;
     }
@@ -904,14 +1182,105 @@ parse_url (Package *pkg, const char *str, const char *path)
   pkg->url = trim_and_sub (pkg, str, path);
 }
 
+/* The keywords of .pc files and their parsers. FIELD is the bit of the
+ * field mask the keyword needs, or 0 if it is always parsed.
+ */
+typedef struct
+{
+  const char *name;
+  gsize len;
+  FieldMask field;
+  void (*parse) (Package *pkg, const char *str, const char *path);
+} Keyword;
+
+#define KEYWORD(name, field, parse) { name, sizeof (name) - 1, field, parse }
+
+static const Keyword keywords[] = {
+  KEYWORD ("Name", 0, parse_name),
+  KEYWORD ("Description", 0, parse_description),
+  KEYWORD ("Version", 0, parse_version),
+  KEYWORD ("Requires.private", FIELD_REQUIRES_PRIVATE, parse_requires_private),
+  KEYWORD ("Requires", FIELD_REQUIRES, parse_requires),
+  KEYWORD ("Libs.private", FIELD_LIBS, parse_libs_private),
+  KEYWORD ("Libs", FIELD_LIBS, parse_libs),
+  KEYWORD ("Cflags", FIELD_CFLAGS, parse_cflags),
+  KEYWORD ("CFlags", FIELD_CFLAGS, parse_cflags),
+  KEYWORD ("Conflicts", FIELD_CONFLICTS, parse_conflicts),
+  KEYWORD ("URL", 0, parse_url),
+  { NULL, 0, 0, NULL }
+};
+
+/* Find the keyword spelled by the LEN characters at TAG. */
+static const Keyword *
+lookup_keyword (const char *tag, gsize len)
+{
+  const Keyword *keyword;
+
+  for (keyword = keywords; keyword->name != NULL; keyword++)
+    {
+      if (keyword->len == len &&
+          keyword->name[0] == tag[0] &&
+          memcmp (keyword->name, tag, len) == 0)
+        return keyword;
+    }
+
+  return NULL;
+}
+
+/* The keyword LINE starts with, if it is a known one. */
+static const Keyword *
+line_keyword (const char *line)
+{
+  const char *tag;
+  const char *p;
+
+  while (IS_SPACE (*line))
+    line++;
+
+  for (tag = p = line; g_ascii_isalnum (*p) || *p == '_' || *p == '.'; p++)
+    ;
+  if (p == tag)
+    return NULL;
+
+  while (IS_SPACE (*p))
+    p++;
+
+  return *p == ':' ? lookup_keyword (tag, p - tag) : NULL;
+}
+
+void
+strip_unparsed_lines (const char *contents, gsize length, FieldMask fields,
+                      GString *out)
+{
+  GString *line = g_string_new (NULL);
+  const char *cursor = contents;
+  const char *start = contents;
+  gsize out_len = out->len;
+
+  while (read_one_line (&cursor, contents + length, line))
+    {
+      const Keyword *keyword = line_keyword (line->str);
+
+      if (keyword == NULL || keyword->field == 0 ||
+          (keyword->field & fields) != 0)
+        g_string_append_len (out, start, cursor - start);
+      start = cursor;
+    }
+  g_string_free (line, TRUE);
+
+  /* Keep a file that only had the dropped lines from looking empty */
+  if (out->len == out_len && length > 0)
+    g_string_append_c (out, '\n');
+}
+
 static void
 parse_line (Package *pkg, const char *untrimmed, const char *path,
-	    gboolean ignore_requires, gboolean ignore_private_libs,
-	    gboolean ignore_requires_private)
+	    FieldMask fields)
 {
   char *str;
   char *p;
-  char *tag;
+  char *tag = NULL;
+  gsize tag_len;
 
   debug_spew ("  line>%s\n", untrimmed);
   
@@ -932,60 +1301,33 @@ parse_line (Package *pkg, const char *untrimmed, const char *path,
 	 *p == '_' || *p == '.')
     p++;
 
-  tag = g_strndup (str, p - str);
-  
-  while (*p && isspace ((guchar)*p))
+  tag_len = p - str;
+
+  while (*p && IS_SPACE (*p))
     ++p;
 
   if (*p == ':')
     {
       /* keyword */
+      const Keyword *keyword;
+
       ++p;
-      while (*p && isspace ((guchar)*p))
+      while (*p && IS_SPACE (*p))
         ++p;
 
-      if (strcmp (tag, "Name") == 0)
-        parse_name (pkg, p, path);
-      else if (strcmp (tag, "Description") == 0)
-        parse_description (pkg, p, path);
-      else if (strcmp (tag, "Version") == 0)
-        parse_version (pkg, p, path);
-      else if (strcmp (tag, "Requires.private") == 0)
-	{
-	  if (!ignore_requires_private)
-	    parse_requires_private (pkg, p, path);
-	}
-      else if (strcmp (tag, "Requires") == 0)
-	{
-          if (ignore_requires == FALSE)
-	    parse_requires (pkg, p, path);
-          else
-	    goto cleanup;
-        }
-      else if (strcmp (tag, "Libs.private") == 0)
-        {
-          if (!ignore_private_libs)
-            parse_libs_private (pkg, p, path);
-        }
-      else if (strcmp (tag, "Libs") == 0)
-        parse_libs (pkg, p, path);
-      else if (strcmp (tag, "Cflags") == 0 ||
-               strcmp (tag, "CFlags") == 0)
-        parse_cflags (pkg, p, path);
-      else if (strcmp (tag, "Conflicts") == 0)
-        parse_conflicts (pkg, p, path);
-      else if (strcmp (tag, "URL") == 0)
-        parse_url (pkg, p, path);
-      else
+      keyword = lookup_keyword (str, tag_len);
+      if (keyword == NULL)
         {
 	  /* we don't error out on unknown keywords because they may
 	   * represent additions to the .pc file format from future
 	   * versions of pkg-config.  We do make a note of them in the
 	   * debug spew though, in order to help catch mistakes in .pc
 	   * files. */
-          debug_spew ("Unknown keyword '%s' in '%s'\n",
-		      tag, path);
+          debug_spew ("Unknown keyword '%.*s' in '%s'\n",
+		      (int) tag_len, str, path);
         }
+      else if (keyword->field == 0 || (fields & keyword->field) != 0)
+        keyword->parse (pkg, p, path);
     }
   else if (*p == '=')
     {
@@ -993,8 +1335,10 @@ parse_line (Package *pkg, const char *untrimmed, const char *path,
       char *varname;
       char *varval;
       
+      tag = g_strndup (str, tag_len);
+
       ++p;
-      while (*p && isspace ((guchar)*p))
+      while (*p && IS_SPACE (*p))
         ++p;
 
       if (define_prefix && strcmp (tag, prefix_variable) == 0)
@@ -1066,16 +1410,34 @@ parse_line (Package *pkg, const char *untrimmed, const char *path,
           verbose_error ("Duplicate definition of variable '%s' in '%s'\n",
                          tag, path);
           if (parse_strict)
-            exit (1);
+            fatal_error ();
           else
             goto cleanup;
         }
 
       varname = g_strdup (tag);
-      varval = trim_and_sub (pkg, p, path);     
 
-      debug_spew (" Variable declaration, '%s' has value '%s'\n",
-                  varname, varval);
+      /* Most variables are never used, so only expand them on demand.
+       * Values with undefined variables are expanded now for the error.
+       */
+      if (var_references_defined (pkg, p))
+        {
+          varval = trim_string (p);
+
+          if (pkg->unexpanded_vars == NULL)
+            pkg->unexpanded_vars = g_hash_table_new (g_str_hash, g_str_equal);
+          g_hash_table_insert (pkg->unexpanded_vars, varname, varname);
+
+          debug_spew (" Variable declaration, '%s' has unexpanded value '%s'\n",
+                      varname, varval);
+        }
+      else
+        {
+          varval = trim_and_sub (pkg, p, path);
+
+          debug_spew (" Variable declaration, '%s' has value '%s'\n",
+                      varname, varval);
+        }
       g_hash_table_insert (pkg->vars, varname, varval);
   
     }
@@ -1085,31 +1447,20 @@ parse_line (Package *pkg, const char *untrimmed, const char *path,
   g_free (tag);
 }
 
-Package*
-parse_package_file (const char *key, const char *path,
-                    gboolean ignore_requires,
-                    gboolean ignore_private_libs,
-                    gboolean ignore_requires_private)
+/* Parse the LENGTH bytes at CONTENTS as the .pc file at PATH. */
+static Package *
+parse_package_contents (const char *key, const char *path,
+                        const char *contents, gsize length,
+                        FieldMask fields)
 {
-  FILE *f;
   Package *pkg;
   GString *str;
   gboolean one_line = FALSE;
-  
-  f = fopen (path, "r");
-
-  if (f == NULL)
-    {
-      verbose_error ("Failed to open '%s': %s\n",
-                     path, strerror (errno));
-      
-      return NULL;
-    }
+  const char *cursor;
 
-  debug_spew ("Parsing package file '%s'\n", path);
-  
   pkg = g_new0 (Package, 1);
   pkg->key = g_strdup (key);
+  pkg->path = g_strdup (path);
 
   if (path)
     {
@@ -1128,29 +1479,175 @@ parse_package_file (const char *key, const char *path,
   g_hash_table_insert (pkg->vars, "pcfiledir", pkg->pcfiledir);
 
   str = g_string_new ("");
+  cursor = contents;
 
-  while (read_one_line (f, str))
+  while (read_one_line (&cursor, contents + length, str))
     {
       one_line = TRUE;
       
-      parse_line (pkg, str->str, path, ignore_requires, ignore_private_libs,
-		  ignore_requires_private);
-
-      g_string_truncate (str, 0);
+      parse_line (pkg, str->str, path, fields);
     }
 
   if (!one_line)
     verbose_error ("Package file '%s' appears to be empty\n",
                    path);
   g_string_free (str, TRUE);
-  fclose(f);
 
   pkg->cflags = g_list_reverse (pkg->cflags);
   pkg->libs = g_list_reverse (pkg->libs);
-  
+
   return pkg;
 }
 
+/* Parse the .pc file at PATH open as F, whose status is ST if known. */
+static Package *
+parse_package_stream (const char *key, const char *path, FILE *f,
+                      const GStatBuf *st, FieldMask fields)
+{
+  Package *pkg;
+  char *contents;
+  gsize length;
+  guint errors;
+  GHashTable *lookups;
+
+  debug_spew ("Parsing package file '%s'\n", path);
+
+  contents = read_file_contents (f, &length);
+  fclose (f);
+
+  errors = verbose_error_count ();
+  lookups = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_private_set (&parse_lookups, lookups);
+
+  pkg = parse_package_contents (key, path, contents, length, fields);
+  g_free (contents);
+
+  /* Only cache clean parses, so that warnings are repeated every time */
+  if (st != NULL && verbose_error_count () == errors)
+    package_cache_save (pkg, path, st, fields, lookups);
+  g_private_set (&parse_lookups, NULL);
+  g_hash_table_destroy (lookups);
+
+  return pkg;
+}
+
+void
+parse_reset (void)
+{
+  GHashTable *lookups = g_private_get (&parse_lookups);
+
+  if (lookups == NULL)
+    return;
+
+  g_private_set (&parse_lookups, NULL);
+  g_hash_table_destroy (lookups);
+}
+
+Package*
+parse_package_file (const char *key, const char *path, FieldMask fields)
+{
+  FILE *f;
+  Package *pkg;
+  GStatBuf st;
+  gboolean have_stat = FALSE;
+
+  f = fopen (path, "r");
+
+  if (f == NULL)
+    {
+      verbose_error ("Failed to open '%s': %s\n",
+                     path, strerror (errno));
+      
+      return NULL;
+    }
+
+  /* The status of the file is only needed for the cache */
+  if (!disable_cache)
+    {
+#ifdef G_OS_UNIX
+      have_stat = fstat (fileno (f), &st) == 0;
+#else
+      have_stat = g_stat (path, &st) == 0;
+#endif
+      pkg = have_stat ? package_cache_load (key, path, &st, fields) : NULL;
+      if (pkg != NULL)
+        {
+          fclose (f);
+          return pkg;
+        }
+    }
+
+  return parse_package_stream (key, path, f, have_stat ? &st : NULL, fields);
+}
+
+#ifdef G_OS_UNIX
+Package *
+parse_package_fd (const char *key, const char *path, int fd,
+                  const GStatBuf *st, FieldMask fields)
+{
+  FILE *f;
+  Package *pkg;
+
+  pkg = package_cache_load (key, path, st, fields);
+  if (pkg != NULL)
+    {
+      close (fd);
+      return pkg;
+    }
+
+  f = fdopen (fd, "r");
+
+  if (f == NULL)
+    {
+      verbose_error ("Failed to open '%s': %s\n",
+                     path, strerror (errno));
+      close (fd);
+
+      return NULL;
+    }
+
+  return parse_package_stream (key, path, f, st, fields);
+}
+#endif
+
+/* Bundle entries and indexed packages are already in memory, so they
+ * skip the compiled package cache.
+ */
+Package *
+parse_package_buffer (const char *key, const char *path,
+                      const char *data, gsize length, FieldMask fields)
+{
+  debug_spew ("Parsing package '%s' from memory\n", path);
+
+  return parse_package_contents (key, path, data, length, fields);
+}
+
+/* Value of the variable VAR defined by PKG itself, expanding it the first
+ * time it is looked up.
+ */
+const char *
+expand_package_var (Package *pkg, const char *var)
+{
+  gpointer name;
+  gpointer value;
+
+  if (pkg->vars == NULL ||
+      !g_hash_table_lookup_extended (pkg->vars, var, &name, &value))
+    return NULL;
+
+  if (pkg->unexpanded_vars != NULL &&
+      g_hash_table_remove (pkg->unexpanded_vars, name))
+    {
+      char *raw = value;
+
+      value = trim_and_sub (pkg, raw, pkg->key);
+      g_hash_table_insert (pkg->vars, name, value);
+      g_free (raw);
+    }
+
+  return value;
+}
+
 /* Parse a package variable. When the value appears to be quoted,
  * unquote it so it can be more easily used in a shell. Otherwise,
  * return the raw value.
@@ -22,15 +22,46 @@
 
 #include "pkg.h"
 
+#include <glib/gstdio.h>
+
 Package *parse_package_file (const char *key, const char *path,
-                             gboolean ignore_requires,
-                             gboolean ignore_private_libs,
-                             gboolean ignore_requires_private);
+                             FieldMask fields);
+
+#ifdef G_OS_UNIX
+/* Parse the .pc file at PATH, already open as FD with the status ST.
+ * FD is closed.
+ */
+Package *parse_package_fd (const char *key, const char *path, int fd,
+                           const GStatBuf *st, FieldMask fields);
+#endif
+
+Package *parse_package_buffer (const char *key, const char *path,
+                               const char *data, gsize length,
+                               FieldMask fields);
+
+/* Split the Libs.private field PKG was parsed with into its libs_private,
+ * see package_get_libs_private().
+ */
+void     parse_package_libs_private (Package *pkg);
 
 GList   *parse_module_list (Package *pkg, const char *str, const char *path);
 
 char    *parse_package_variable (Package *pkg, const char *variable);
 
+void     append_escape_shell (GString *str, const char *s, gsize len);
+
+/* Append to OUT the lines of the LENGTH bytes at CONTENTS that are parsed
+ * with the field mask FIELDS, as they are written there. Parsing OUT
+ * with FIELDS gives the same package as parsing CONTENTS.
+ */
+void     strip_unparsed_lines (const char *contents, gsize length,
+                               FieldMask fields, GString *out);
+
+const char *expand_package_var (Package *pkg, const char *var);
+
+/* Forget the parse fatal_error() broke out of, if any. */
+void     parse_reset (void);
+
 #endif
 
 
@@ -25,6 +25,9 @@
 #include "pkg.h"
 #include "parse.h"
 #include "rpmvercmp.h"
+#include "cache.h"
+#include "bundle.h"
+#include "pkgindex.h"
 
 #ifdef HAVE_MALLOC_H
 # include <malloc.h>
@@ -39,22 +42,83 @@
 #endif
 #include <stdlib.h>
 #include <ctype.h>
+#include <time.h>
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
 
 static void verify_package (Package *pkg);
 
+typedef struct
+{
+  char *path;
+  unsigned int position; /* in the search path as given */
+  DirIndex *index; /* NULL if the directory has to be probed */
+  gboolean index_loaded;
+  Bundle *bundle; /* NULL if the directory has no bundle */
+  gboolean bundle_loaded;
+  PkgIndex *pkg_index; /* NULL unless an up to date index was built */
+  gboolean pkg_index_loaded;
+  GStatBuf listed_st; /* status when its names were gathered */
+  gboolean listed_exists;
+  gboolean listed_racy;
+#ifdef G_OS_UNIX
+  int fd; /* the open directory, or -1 */
+  int fd_errno; /* why the directory could not be opened */
+  gboolean fd_opened;
+#endif
+} SearchDir;
+
 static GHashTable *packages = NULL;
 static GHashTable *globals = NULL;
-static GList *search_dirs = NULL;
+
+/* Packages parsed with each parse_fields mask, which --batch queries
+ * switch between.
+ */
+static GHashTable *package_tables[FIELDS_ALL + 1];
+static GList *search_dirs = NULL; /* list of SearchDir */
+
+/* Directories of the search path that were no directory when it was
+ * resolved, which a --batch query looks at again.
+ */
+static GList *missing_search_dirs = NULL; /* list of SearchDir */
+
+/* Names of all packages in the search path, gathered when the first
+ * package is looked up so that a name found in no directory costs no
+ * system call. NULL if some directory could not be listed.
+ */
+static GHashTable *search_path_names = NULL;
+static gboolean search_path_names_gathered = FALSE;
+
+/* Status of a file packages were loaded from */
+typedef struct
+{
+  GStatBuf st;
+  gboolean racy; /* could change without its status moving */
+} LoadedFile;
+
+/* The files the known packages were loaded from, by path, which each
+ * --batch query checks before reusing the packages. Files right in a
+ * search directory are only kept if they were racy, as the directory
+ * is checked already.
+ */
+static GHashTable *loaded_files = NULL;
 
 gboolean disable_uninstalled = FALSE;
-gboolean ignore_requires = FALSE;
-gboolean ignore_requires_private = TRUE;
-gboolean ignore_private_libs = TRUE;
+FieldMask parse_fields = FIELD_REQUIRES | FIELD_CONFLICTS | FIELD_LIBS |
+                         FIELD_CFLAGS;
 
 void
 add_search_dir (const char *path)
 {
-  search_dirs = g_list_append (search_dirs, g_strdup (path));
+  static unsigned int n_search_dirs = 0;
+  SearchDir *search_dir = g_new0 (SearchDir, 1);
+
+  search_dir->path = g_strdup (path);
+  search_dir->position = ++n_search_dirs;
+  search_dirs = g_list_append (search_dirs, search_dir);
 }
 
 void
@@ -78,6 +142,104 @@ add_search_dirs (const char *path, const char *separator)
       g_strfreev (search_dirs);
 }
 
+/* Whether the path of SEARCH_DIR is a directory, whose status is then put
+ * in ST.
+ */
+static gboolean
+search_dir_is_dir (SearchDir *search_dir, GStatBuf *st)
+{
+  if (g_stat (search_dir->path, st) != 0)
+    {
+      debug_spew ("Dropping directory '%s' from the search path: %s\n",
+                  search_dir->path, g_strerror (errno));
+      return FALSE;
+    }
+
+  if (!S_ISDIR (st->st_mode))
+    {
+      debug_spew ("Dropping '%s' from the search path, which is not a "
+                  "directory\n", search_dir->path);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+void
+resolve_search_dirs (void)
+{
+  GHashTable *seen;
+  GList *iter;
+
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  iter = search_dirs;
+  while (iter != NULL)
+    {
+      GList *next = g_list_next (iter);
+      SearchDir *search_dir = iter->data;
+      SearchDir *first = NULL;
+      GStatBuf st;
+#ifndef G_OS_WIN32
+      char *id;
+#endif
+
+      if (!search_dir_is_dir (search_dir, &st))
+        {
+          /* It may still be created while --batch runs */
+          search_dirs = g_list_remove_link (search_dirs, iter);
+          missing_search_dirs = g_list_concat (missing_search_dirs, iter);
+          iter = next;
+          continue;
+        }
+
+#ifndef G_OS_WIN32
+      /* Windows has no inode numbers to tell aliases apart */
+      id = g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT,
+                            (guint64) st.st_dev, (guint64) st.st_ino);
+
+      first = g_hash_table_lookup (seen, id);
+      if (first == NULL)
+        g_hash_table_insert (seen, id, search_dir);
+      else
+        {
+          debug_spew ("Dropping directory '%s' from the search path, "
+                      "the same as '%s'\n", search_dir->path,
+                      first->path);
+          g_free (id);
+        }
+#endif
+      if (first == NULL)
+        {
+          iter = next;
+          continue;
+        }
+
+      search_dirs = g_list_delete_link (search_dirs, iter);
+      g_free (search_dir->path);
+      g_free (search_dir);
+      iter = next;
+    }
+
+  g_hash_table_destroy (seen);
+}
+
+GList *
+get_search_dir_paths (void)
+{
+  GList *paths = NULL;
+  GList *iter;
+
+  for (iter = search_dirs; iter != NULL; iter = g_list_next (iter))
+    {
+      SearchDir *search_dir = iter->data;
+
+      paths = g_list_prepend (paths, search_dir->path);
+    }
+
+  return g_list_reverse (paths);
+}
+
 #ifdef G_OS_WIN32
 /* Guard against .pc file being installed with UPPER CASE name */
 # define FOLD(x) tolower(x)
@@ -121,14 +283,177 @@ name_ends_in_uninstalled (const char *str)
 static Package *
 internal_get_package (const char *name, gboolean warn);
 
+static void
+add_package (Package *pkg, const char *location, unsigned int path_position,
+             gboolean warn);
+
+static Bundle *search_dir_get_bundle (SearchDir *search_dir);
+static PkgIndex *search_dir_get_pkg_index (SearchDir *search_dir);
+static void refresh_packages (void);
+#ifdef G_OS_UNIX
+static int search_dir_get_fd (SearchDir *search_dir);
+#endif
+
+/* A .pc file to parse when listing all packages */
+typedef struct
+{
+  char *key;
+  char *path;
+  /* Contents of the file if they are in memory already, else NULL */
+  const char *data;
+  gsize length;
+  Package *pkg;
+  /* What parsing it reported, printed once the files before are added */
+  GString *messages;
+} ListedFile;
+
+/* Add the file at PATH for the package KEY to FILES unless it was found
+ * earlier. Takes ownership of KEY and PATH.
+ */
+static ListedFile *
+add_listed_file (GHashTable *seen, GList **files, char *key, char *path)
+{
+  ListedFile *file;
+
+  if (g_hash_table_lookup (seen, key) != NULL)
+    {
+      debug_spew ("Ignoring '%s', found earlier in the search path\n",
+                  path);
+      g_free (key);
+      g_free (path);
+      return NULL;
+    }
+
+  file = g_new0 (ListedFile, 1);
+  file->key = key;
+  file->path = path;
+  g_hash_table_insert (seen, file->key, file);
+  *files = g_list_prepend (*files, file);
+
+  return file;
+}
+
+/* List the packages of an up to date index instead of the directory. */
+static void
+scan_pkg_index (const char *dirname, PkgIndex *pkg_index, GHashTable *seen,
+                GList **files)
+{
+  /* The indexed lines do not do for all the fields */
+  gboolean use_data = (parse_fields & ~PKG_INDEX_FIELDS) == 0;
+  guint i;
+
+  debug_spew ("Scanning index of directory '%s'\n", dirname);
+
+  for (i = 0; i < pkg_index_get_size (pkg_index); i++)
+    {
+      PkgIndexEntry entry;
+      ListedFile *file;
+      char *filename;
+      GStatBuf st;
+
+      if (!pkg_index_get_entry (pkg_index, i, &entry))
+        continue;
+
+      filename = g_strconcat (entry.key, ".pc", NULL);
+      file = add_listed_file (seen, files, g_strdup (entry.key),
+                              g_build_filename (dirname, filename, NULL));
+      g_free (filename);
+
+      /* A file edited in place leaves the directory as it was */
+      if (file != NULL && use_data &&
+          g_stat (file->path, &st) == 0 &&
+          pkg_index_entry_fresh (&entry, &st))
+        {
+          file->data = entry.data;
+          file->length = entry.length;
+        }
+    }
+}
+
+#ifdef G_OS_UNIX
+/* Whether the entry of DIR is a regular file, or a link to one, going
+ * by the type readdir() returned when it is known.
+ */
+static gboolean
+dir_entry_is_file (DIR *dir, const struct dirent *dent)
+{
+  struct stat st;
+
+#ifdef DT_UNKNOWN
+  if (dent->d_type == DT_REG)
+    return TRUE;
+  if (dent->d_type != DT_UNKNOWN && dent->d_type != DT_LNK)
+    return FALSE;
+#endif
+
+  return fstatat (dirfd (dir), dent->d_name, &st, 0) == 0 &&
+         S_ISREG (st.st_mode);
+}
+
+/* List the directory through its open fd, so that its entries need no
+ * path to be checked. Returns FALSE if it cannot be read this way.
+ */
+static gboolean
+scan_dir_fd (SearchDir *search_dir, GHashTable *seen, GList **files)
+{
+  const char *dirname = search_dir->path;
+  struct dirent *dent;
+  DIR *dir;
+  int fd;
+
+  if (search_dir_get_fd (search_dir) < 0)
+    return FALSE;
+
+  /* The fd kept for probing may not be readable itself */
+  fd = openat (search_dir->fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+    return FALSE;
+
+  dir = fdopendir (fd);
+  if (dir == NULL)
+    {
+      close (fd);
+      return FALSE;
+    }
+
+  debug_spew ("Scanning directory '%s'\n", dirname);
+
+  while ((dent = readdir (dir)) != NULL)
+    {
+      const char *filename = dent->d_name;
+
+      if (!ends_in_dotpc (filename))
+        continue;
+
+      if (!dir_entry_is_file (dir, dent))
+        {
+          debug_spew ("Ignoring '%s' in '%s', which is not a file\n",
+                      filename, dirname);
+          continue;
+        }
+
+      add_listed_file (seen, files,
+                       g_strndup (filename, strlen (filename) - EXT_LEN),
+                       g_build_filename (dirname, filename, NULL));
+    }
+  closedir (dir);
+
+  return TRUE;
+}
+#endif
+
 /* Look for .pc files in the given directory and add them into
- * locations, ignoring duplicates
+ * FILES, ignoring duplicates of the packages in SEEN
  */
 static void
-scan_dir (char *dirname)
+scan_dir (SearchDir *search_dir, GHashTable *seen, GList **files)
 {
   GDir *dir;
   const gchar *filename;
+  char *dirname = search_dir->path;
+  PkgIndex *pkg_index;
+  Bundle *bundle;
+  GList *iter;
 
   int dirnamelen = strlen (dirname);
   /* Use a copy of dirname cause Win32 opendir doesn't like
@@ -157,25 +482,80 @@ scan_dir (char *dirname)
         }
     }
 #endif
-  dir = g_dir_open (dirname_copy, 0 , NULL);
-  g_free (dirname_copy);
 
-  if (!dir)
+  pkg_index = search_dir_get_pkg_index (search_dir);
+  if (pkg_index != NULL)
     {
-      debug_spew ("Cannot open directory '%s' in package search path: %s\n",
-                  dirname, g_strerror (errno));
-      return;
+      g_free (dirname_copy);
+      scan_pkg_index (dirname, pkg_index, seen, files);
     }
+#ifdef G_OS_UNIX
+  else if (scan_dir_fd (search_dir, seen, files))
+    g_free (dirname_copy);
+#endif
+  else
+    {
+      dir = g_dir_open (dirname_copy, 0 , NULL);
+      g_free (dirname_copy);
 
-  debug_spew ("Scanning directory '%s'\n", dirname);
+      if (!dir)
+        {
+          debug_spew ("Cannot open directory '%s' in package search path: "
+                      "%s\n", dirname, g_strerror (errno));
+          return;
+        }
+
+      debug_spew ("Scanning directory '%s'\n", dirname);
+
+      while ((filename = g_dir_read_name(dir)))
+        {
+          if (!ends_in_dotpc (filename))
+            continue;
+
+          add_listed_file (seen, files,
+                           g_strndup (filename, strlen (filename) - EXT_LEN),
+                           g_build_filename (dirname, filename, NULL));
+        }
+      g_dir_close (dir);
+    }
 
-  while ((filename = g_dir_read_name(dir)))
+  /* Real files take precedence over the bundle in the same directory */
+  bundle = search_dir_get_bundle (search_dir);
+  if (bundle == NULL)
+    return;
+
+  for (iter = bundle_get_entries (bundle); iter != NULL;
+       iter = g_list_next (iter))
     {
-      char *path = g_build_filename (dirname, filename, NULL);
-      internal_get_package (path, FALSE);
-      g_free (path);
+      const BundleEntry *entry = iter->data;
+      ListedFile *file;
+
+      file = add_listed_file (seen, files, g_strdup (entry->key),
+                              g_strdup (entry->path));
+      if (file != NULL)
+        {
+          file->data = entry->data;
+          file->length = entry->length;
+        }
     }
-  g_dir_close (dir);
+}
+
+static void
+parse_listed_file (gpointer data, gpointer user_data)
+{
+  ListedFile *file = data;
+
+  file->messages = g_string_new (NULL);
+  collect_messages (file->messages);
+
+  if (file->data != NULL)
+    file->pkg = parse_package_buffer (file->key, file->path,
+                                      file->data, file->length,
+                                      parse_fields);
+  else
+    file->pkg = parse_package_file (file->key, file->path, parse_fields);
+
+  collect_messages (NULL);
 }
 
 static Package *
@@ -194,7 +574,8 @@ add_virtual_pkgconfig_package (void)
 
   if (pkg->vars == NULL)
     pkg->vars = g_hash_table_new (g_str_hash, g_str_equal);
-  g_hash_table_insert (pkg->vars, "pc_path", pkg_config_pc_path);
+  g_hash_table_insert (pkg->vars, g_strdup ("pc_path"),
+                       g_strdup (pkg_config_pc_path));
 
   debug_spew ("Adding virtual 'pkg-config' package to list of known packages\n");
   g_hash_table_insert (packages, pkg->key, pkg);
@@ -202,16 +583,83 @@ add_virtual_pkgconfig_package (void)
   return pkg;
 }
 
+/* Files each parsing thread should have at least, as starting threads
+ * costs more than parsing a few files.
+ */
+#define LISTED_FILES_PER_THREAD 16
+
+/* Add the packages of all .pc files in the search path. Parsing is
+ * what takes the time, so the files are parsed by a pool of threads,
+ * then added in search path order along with what parsing reported.
+ */
+static void
+add_all_packages (void)
+{
+  GHashTable *seen;
+  GList *files = NULL;
+  GList *iter;
+  GThreadPool *pool = NULL;
+  guint n_threads;
+
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  for (iter = search_dirs; iter != NULL; iter = g_list_next (iter))
+    scan_dir (iter->data, seen, &files);
+  g_hash_table_destroy (seen);
+
+  files = g_list_reverse (files);
+  n_threads = MIN (g_get_num_processors (),
+                   g_list_length (files) / LISTED_FILES_PER_THREAD);
+
+  if (n_threads > 1)
+    pool = g_thread_pool_new (parse_listed_file, NULL, n_threads,
+                              FALSE, NULL);
+
+  for (iter = files; iter != NULL; iter = g_list_next (iter))
+    {
+      if (pool == NULL ||
+          !g_thread_pool_push (pool, iter->data, NULL))
+        parse_listed_file (iter->data, NULL);
+    }
+
+  if (pool != NULL)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (iter = files; iter != NULL; iter = g_list_next (iter))
+    {
+      ListedFile *file = iter->data;
+
+      print_messages (file->messages);
+      g_string_free (file->messages, TRUE);
+
+      /* Requires may have pulled in the package already */
+      if (file->pkg != NULL &&
+          g_hash_table_lookup (packages, file->key) == NULL)
+        add_package (file->pkg, file->path, 0, FALSE);
+
+      g_free (file->key);
+      g_free (file->path);
+      g_free (file);
+    }
+  g_list_free (files);
+}
+
 void
 package_init (gboolean want_list)
 {
-  if (packages)
-    return;
+  GHashTable **table = &package_tables[parse_fields];
+
+  refresh_packages ();
+
+  if (*table)
+    {
+      packages = *table;
+      return;
+    }
       
-  packages = g_hash_table_new (g_str_hash, g_str_equal);
+  packages = *table = g_hash_table_new (g_str_hash, g_str_equal);
 
   if (want_list)
-    g_list_foreach (search_dirs, (GFunc)scan_dir, NULL);
+    add_all_packages ();
   else
     /* Should not add virtual pkgconfig package when listing to be
      * compatible with old code that only listed packages from real
@@ -219,101 +667,553 @@ package_init (gboolean want_list)
     add_virtual_pkgconfig_package ();
 }
 
-static Package *
-internal_get_package (const char *name, gboolean warn)
+/* Load the index of the directory the first time it is needed. */
+static DirIndex *
+search_dir_get_index (SearchDir *search_dir)
 {
-  Package *pkg = NULL;
-  char *key = NULL;
-  char *location = NULL;
-  unsigned int path_position = 0;
-  GList *iter;
-  GList *dir_iter;
-  
-  pkg = g_hash_table_lookup (packages, name);
-
-  if (pkg)
-    return pkg;
-
-  debug_spew ("Looking for package '%s'\n", name);
-  
-  /* treat "name" as a filename if it ends in .pc and exists */
-  if ( ends_in_dotpc (name) )
+  if (!search_dir->index_loaded)
     {
-      debug_spew ("Considering '%s' to be a filename rather than a package name\n", name);
-      location = g_strdup (name);
-      key = g_strdup (name);
+      search_dir->index = dir_index_load (search_dir->path);
+      search_dir->index_loaded = TRUE;
     }
-  else
-    {
-      /* See if we should auto-prefer the uninstalled version */
-      if (!disable_uninstalled &&
-          !name_ends_in_uninstalled (name))
-        {
-          char *un;
 
-          un = g_strconcat (name, "-uninstalled", NULL);
+  return search_dir->index;
+}
 
-          pkg = internal_get_package (un, FALSE);
+/* Check the index of the directory, if there is one, before touching
+ * the filesystem.
+ */
+static gboolean
+search_dir_may_contain (SearchDir *search_dir, const char *name)
+{
+  DirIndex *index = search_dir_get_index (search_dir);
 
-          g_free (un);
-          
-          if (pkg)
-            {
-              debug_spew ("Preferring uninstalled version of package '%s'\n", name);
-              return pkg;
-            }
-        }
-      
-      for (dir_iter = search_dirs; dir_iter != NULL;
-           dir_iter = g_list_next (dir_iter))
-        {
-          path_position++;
-          location = g_strdup_printf ("%s%c%s.pc", (char*)dir_iter->data,
-                                      G_DIR_SEPARATOR, name);
-          if (g_file_test (location, G_FILE_TEST_IS_REGULAR))
-            break;
-          g_free (location);
-          location = NULL;
-        }
+  if (index == NULL)
+    return TRUE;
 
-    }
-  
-  if (location == NULL)
-    {
-      if (warn)
-        verbose_error ("Package %s was not found in the pkg-config search path.\n"
-                       "Perhaps you should add the directory containing `%s.pc'\n"
-                       "to the PKG_CONFIG_PATH environment variable\n",
-                       name, name);
+  return dir_index_may_contain (index, name);
+}
 
-      return NULL;
+#ifdef G_OS_UNIX
+#ifndef O_CLOEXEC
+# define O_CLOEXEC 0
+#endif
+#ifdef O_PATH
+# define DIR_FD_FLAGS (O_PATH | O_DIRECTORY | O_CLOEXEC)
+#else
+# define DIR_FD_FLAGS (O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+#endif
+
+/* Longest file name probed for without allocating */
+#define PROBE_NAME_MAX 256
+
+/* Open the directory the first time it is needed, returning -1 if it
+ * cannot be.
+ */
+static int
+search_dir_get_fd (SearchDir *search_dir)
+{
+  if (!search_dir->fd_opened)
+    {
+      search_dir->fd = open (search_dir->path, DIR_FD_FLAGS);
+      search_dir->fd_errno = errno;
+      search_dir->fd_opened = TRUE;
     }
 
-  if (key == NULL)
-    key = g_strdup (name);
+  return search_dir->fd;
+}
+
+/* Open NAME.pc in the directory, which is kept open so that probing it
+ * does not resolve its path every time. Returns -1 unless a regular
+ * file was opened, whose status is then put in ST. Anything else is
+ * opened without blocking, so that a FIFO does not hang the probe.
+ */
+static int
+search_dir_open (SearchDir *search_dir, const char *name, GStatBuf *st)
+{
+  char buf[PROBE_NAME_MAX];
+  char *filename = buf;
+  gsize len = strlen (name);
+  int fd;
+
+  search_dir_get_fd (search_dir);
+
+  if (len + sizeof (".pc") > sizeof (buf))
+    filename = g_malloc (len + sizeof (".pc"));
+  memcpy (filename, name, len);
+  memcpy (filename + len, ".pc", sizeof (".pc"));
+
+  if (search_dir->fd >= 0)
+    fd = openat (search_dir->fd, filename,
+                 O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  else if (search_dir->fd_errno == ENOENT ||
+           search_dir->fd_errno == ENOTDIR)
+    fd = -1;
   else
     {
-      /* need to strip package name out of the filename */
-      key = g_path_get_basename (name);
-      key[strlen (key) - EXT_LEN] = '\0';
+      /* The directory may still be searchable without being readable */
+      char *path = g_strdup_printf ("%s%c%s", search_dir->path,
+                                    G_DIR_SEPARATOR, filename);
+
+      fd = open (path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+      g_free (path);
     }
 
-  debug_spew ("Reading '%s' from file '%s'\n", name, location);
-  pkg = parse_package_file (key, location, ignore_requires,
-                            ignore_private_libs, ignore_requires_private);
-  g_free (key);
+  if (filename != buf)
+    g_free (filename);
 
-  if (pkg != NULL && strstr (location, "uninstalled.pc"))
-    pkg->uninstalled = TRUE;
+  if (fd >= 0 && (fstat (fd, st) != 0 || !S_ISREG (st->st_mode) ||
+                  fcntl (fd, F_SETFL,
+                         fcntl (fd, F_GETFL) & ~O_NONBLOCK) != 0))
+    {
+      close (fd);
+      fd = -1;
+    }
 
-  g_free (location);
+  return fd;
+}
+#endif
 
-  if (pkg == NULL)
+/* Map the index built for the directory the first time it is needed. */
+static PkgIndex *
+search_dir_get_pkg_index (SearchDir *search_dir)
+{
+  if (!search_dir->pkg_index_loaded)
     {
-      debug_spew ("Failed to parse '%s'\n", location);
+      search_dir->pkg_index = pkg_index_load (search_dir->path);
+      search_dir->pkg_index_loaded = TRUE;
+    }
+
+  return search_dir->pkg_index;
+}
+
+/* Map the bundle of the directory the first time it is needed. */
+static Bundle *
+search_dir_get_bundle (SearchDir *search_dir)
+{
+  if (!search_dir->bundle_loaded)
+    {
+      search_dir->bundle = bundle_load (search_dir->path);
+      search_dir->bundle_loaded = TRUE;
+    }
+
+  return search_dir->bundle;
+}
+
+/* Drop everything loaded from the directory, to be loaded again when
+ * it is next needed.
+ */
+static void
+search_dir_forget (SearchDir *search_dir)
+{
+  if (search_dir->index != NULL)
+    dir_index_free (search_dir->index);
+  search_dir->index = NULL;
+  search_dir->index_loaded = FALSE;
+
+  if (search_dir->pkg_index != NULL)
+    pkg_index_free (search_dir->pkg_index);
+  search_dir->pkg_index = NULL;
+  search_dir->pkg_index_loaded = FALSE;
+
+  if (search_dir->bundle != NULL)
+    bundle_free (search_dir->bundle);
+  search_dir->bundle = NULL;
+  search_dir->bundle_loaded = FALSE;
+
+#ifdef G_OS_UNIX
+  /* The directory may have been replaced */
+  if (search_dir->fd_opened && search_dir->fd >= 0)
+    close (search_dir->fd);
+  search_dir->fd_opened = FALSE;
+#endif
+}
+
+static void
+search_path_names_add (GHashTable *names, const char *name)
+{
+#ifdef G_OS_WIN32
+  g_hash_table_add (names, g_ascii_strdown (name, -1));
+#else
+  g_hash_table_add (names, g_strdup (name));
+#endif
+}
+
+/* Collect the names of the packages in all search directories, from
+ * their package index if they have an up to date one, else from a
+ * listing of the directory, and from their bundle. Returns NULL if some
+ * directory cannot be listed, or may have files whose names differ from
+ * the listed ones only in case, as a miss would prove nothing then.
+ */
+static GHashTable *
+gather_search_path_names (void)
+{
+  GHashTable *names;
+  gboolean complete = TRUE;
+  gboolean exact = TRUE;
+  GList *iter;
+
+  names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (iter = search_dirs; iter != NULL; iter = g_list_next (iter))
+    {
+      SearchDir *search_dir = iter->data;
+      PkgIndex *pkg_index;
+      DirIndex *index;
+      Bundle *bundle;
+      GList *entry_iter;
+
+      /* Taken before listing, so that any later change is noticed.
+       * Files can be added to a racy directory without its mtime
+       * moving.
+       */
+      search_dir->listed_exists = g_stat (search_dir->path,
+                                          &search_dir->listed_st) == 0;
+      search_dir->listed_racy =
+        search_dir->listed_exists &&
+        time (NULL) - search_dir->listed_st.st_mtime < RACY_MTIME_SECONDS;
+
+      pkg_index = search_dir_get_pkg_index (search_dir);
+      if (pkg_index != NULL)
+        {
+          guint i;
+
+          for (i = 0; i < pkg_index_get_size (pkg_index); i++)
+            {
+              PkgIndexEntry entry;
+
+              if (pkg_index_get_entry (pkg_index, i, &entry))
+                search_path_names_add (names, entry.key);
+            }
+
+          if (!pkg_index_is_exact (pkg_index))
+            exact = FALSE;
+        }
+      else if ((index = search_dir_get_index (search_dir)) != NULL)
+        {
+          dir_index_add_names (index, names);
+
+          if (!dir_index_is_exact (index))
+            exact = FALSE;
+        }
+      else
+        complete = FALSE;
+
+      bundle = search_dir_get_bundle (search_dir);
+      if (bundle == NULL)
+        continue;
+
+      for (entry_iter = bundle_get_entries (bundle); entry_iter != NULL;
+           entry_iter = g_list_next (entry_iter))
+        {
+          const BundleEntry *entry = entry_iter->data;
+
+          search_path_names_add (names, entry->key);
+        }
+    }
+
+  if (!complete)
+    {
+      debug_spew ("Not all search directories could be listed, probing "
+                  "them for every package\n");
+      g_hash_table_destroy (names);
+      return NULL;
+    }
+
+  if (!exact)
+    {
+      debug_spew ("Some search directories may not match package names "
+                  "exactly, probing them for every package\n");
+      g_hash_table_destroy (names);
       return NULL;
     }
 
+  debug_spew ("Found %u package names in the search path\n",
+              g_hash_table_size (names));
+
+  return names;
+}
+
+/* Returns FALSE only if no search directory can have a package NAME. */
+static gboolean
+search_path_may_contain (const char *name)
+{
+  gboolean found;
+
+  /* Names with a directory part refer below the search directories */
+  if (strchr (name, '/') != NULL || strchr (name, G_DIR_SEPARATOR) != NULL)
+    return TRUE;
+
+  if (!search_path_names_gathered)
+    {
+      search_path_names = gather_search_path_names ();
+      search_path_names_gathered = TRUE;
+    }
+
+  if (search_path_names == NULL)
+    return TRUE;
+
+#ifdef G_OS_WIN32
+  {
+    char *folded = g_ascii_strdown (name, -1);
+    found = g_hash_table_contains (search_path_names, folded);
+    g_free (folded);
+  }
+#else
+  found = g_hash_table_contains (search_path_names, name);
+#endif
+
+  return found;
+}
+
+/* Record the status of the file at PATH, ST if it is known already, that
+ * a package was just loaded from. A file IN_SEARCH_DIR is only looked at
+ * again when its directory changes, unless it was racy.
+ */
+static void
+remember_loaded_file (const char *path, const GStatBuf *st,
+                      gboolean in_search_dir)
+{
+  LoadedFile *file = g_new0 (LoadedFile, 1);
+
+  if (st != NULL)
+    file->st = *st;
+  else if (g_stat (path, &file->st) != 0)
+    file->racy = TRUE;
+
+  if (time (NULL) - file->st.st_mtime < RACY_MTIME_SECONDS)
+    file->racy = TRUE;
+
+  if (in_search_dir && !file->racy)
+    {
+      g_free (file);
+      return;
+    }
+
+  if (loaded_files == NULL)
+    loaded_files = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, g_free);
+  g_hash_table_replace (loaded_files, g_strdup (path), file);
+}
+
+/* Whether a file packages were loaded from changed, or may have. */
+static gboolean
+loaded_files_changed (void)
+{
+  GHashTableIter iter;
+  gpointer path;
+  gpointer value;
+
+  if (loaded_files == NULL)
+    return FALSE;
+
+  g_hash_table_iter_init (&iter, loaded_files);
+  while (g_hash_table_iter_next (&iter, &path, &value))
+    {
+      LoadedFile *file = value;
+      GStatBuf st;
+
+      if (file->racy || g_stat (path, &st) != 0 ||
+          st.st_mtime != file->st.st_mtime ||
+          st.st_ctime != file->st.st_ctime ||
+          st.st_size != file->st.st_size ||
+          st.st_dev != file->st.st_dev ||
+          st.st_ino != file->st.st_ino)
+        {
+          debug_spew ("File '%s' may have changed, loading packages "
+                      "again\n", (char *) path);
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+static gint
+compare_search_dir_positions (gconstpointer a, gconstpointer b)
+{
+  const SearchDir *dir_a = a;
+  const SearchDir *dir_b = b;
+
+  return dir_a->position < dir_b->position ? -1 : 1;
+}
+
+/* Forget what was loaded from the search directories that changed, or
+ * may have, since their names were gathered, and all packages if any
+ * of them or of their files did, or a missing directory was created. A
+ * --batch query then finds packages added or edited since the previous
+ * ones.
+ */
+static void
+refresh_packages (void)
+{
+  gboolean changed = FALSE;
+  GList *iter;
+
+  for (iter = search_path_names_gathered ? search_dirs : NULL;
+       iter != NULL; iter = g_list_next (iter))
+    {
+      SearchDir *search_dir = iter->data;
+      GStatBuf st;
+      gboolean exists = g_stat (search_dir->path, &st) == 0;
+
+      if (!search_dir->listed_racy &&
+          exists == search_dir->listed_exists &&
+          (!exists ||
+           (st.st_mtime == search_dir->listed_st.st_mtime &&
+            st.st_dev == search_dir->listed_st.st_dev &&
+            st.st_ino == search_dir->listed_st.st_ino)))
+        continue;
+
+      debug_spew ("Directory '%s' may have changed, loading it again\n",
+                  search_dir->path);
+      search_dir_forget (search_dir);
+      changed = TRUE;
+    }
+
+  /* A directory missing from the search path may have been created since
+   * the previous query. There was none before the first.
+   */
+  iter = packages != NULL ? missing_search_dirs : NULL;
+  while (iter != NULL)
+    {
+      GList *next = g_list_next (iter);
+      SearchDir *search_dir = iter->data;
+      GStatBuf st;
+
+      if (g_stat (search_dir->path, &st) == 0 && S_ISDIR (st.st_mode))
+        {
+          debug_spew ("Adding directory '%s' back to the search path\n",
+                      search_dir->path);
+          missing_search_dirs = g_list_delete_link (missing_search_dirs,
+                                                    iter);
+          search_dirs = g_list_insert_sorted (search_dirs, search_dir,
+                                              compare_search_dir_positions);
+          changed = TRUE;
+        }
+
+      iter = next;
+    }
+
+  if (changed)
+    {
+      if (search_path_names != NULL)
+        g_hash_table_destroy (search_path_names);
+      search_path_names = NULL;
+      search_path_names_gathered = FALSE;
+    }
+
+  /* Any package may now be shadowed, or depend on one that changed */
+  if (changed || loaded_files_changed ())
+    package_reset ();
+}
+
+static void
+free_module_list (GList *list)
+{
+  GList *iter;
+
+  for (iter = list; iter != NULL; iter = g_list_next (iter))
+    {
+      RequiredVersion *ver = iter->data;
+
+      g_free (ver->name);
+      g_free (ver->version);
+      g_free (ver);
+    }
+  g_list_free (list);
+}
+
+static gboolean
+free_var (gpointer key, gpointer value, gpointer data)
+{
+  if (strcmp (key, "pcfiledir") != 0)
+    {
+      g_free (key);
+      g_free (value);
+    }
+
+  return TRUE;
+}
+
+void
+package_free (Package *pkg)
+{
+  g_free (pkg->key);
+  g_free (pkg->name);
+  g_free (pkg->version);
+  g_free (pkg->description);
+  g_free (pkg->url);
+  g_free (pkg->orig_prefix);
+  if (pkg->vars != NULL)
+    {
+      g_hash_table_foreach_remove (pkg->vars, free_var, NULL);
+      g_hash_table_destroy (pkg->vars);
+    }
+  if (pkg->unexpanded_vars != NULL)
+    g_hash_table_destroy (pkg->unexpanded_vars);
+  if (pkg->required_versions != NULL)
+    g_hash_table_destroy (pkg->required_versions);
+  g_free (pkg->pcfiledir);
+  g_free (pkg->path);
+  free_module_list (pkg->requires_entries);
+  free_module_list (pkg->requires_private_entries);
+  free_module_list (pkg->conflicts);
+  g_list_free (pkg->requires);
+  g_list_free (pkg->requires_private);
+  /* The arguments are allocated along with the flags */
+  g_list_free_full (pkg->libs, g_free);
+  g_list_free_full (pkg->libs_private, g_free);
+  g_free (pkg->libs_private_field);
+  g_list_free_full (pkg->cflags, g_free);
+  g_free (pkg);
+}
+
+static gboolean
+free_package (gpointer key, gpointer value, gpointer data)
+{
+  package_free (value);
+
+  return TRUE;
+}
+
+/* Forget all packages, which may have been left half set up by an
+ * abandoned --batch query.
+ */
+void
+package_reset (void)
+{
+  int i;
+
+  parse_reset ();
+
+  for (i = 0; i < (int) G_N_ELEMENTS (package_tables); i++)
+    {
+      if (package_tables[i] == NULL)
+        continue;
+      g_hash_table_foreach_remove (package_tables[i], free_package, NULL);
+      g_hash_table_destroy (package_tables[i]);
+      package_tables[i] = NULL;
+    }
+  packages = NULL;
+
+  if (loaded_files != NULL)
+    g_hash_table_destroy (loaded_files);
+  loaded_files = NULL;
+}
+
+/* Add PKG, just parsed from the file at LOCATION, to the known packages
+ * and pull in its requirements.
+ */
+static void
+add_package (Package *pkg, const char *location, unsigned int path_position,
+             gboolean warn)
+{
+  GList *iter;
+
+  if (strstr (location, "uninstalled.pc"))
+    pkg->uninstalled = TRUE;
+
   pkg->path_position = path_position;
 
   debug_spew ("Path position of '%s' is %d\n",
@@ -335,7 +1235,7 @@ internal_get_package (const char *name, gboolean warn)
         {
           verbose_error ("Package '%s', required by '%s', not found\n",
                          ver->name, pkg->key);
-          exit (1);
+          fatal_error ();
         }
 
       if (pkg->required_versions == NULL)
@@ -359,7 +1259,7 @@ internal_get_package (const char *name, gboolean warn)
         {
           verbose_error ("Package '%s', required by '%s', not found\n",
 			 ver->name, pkg->key);
-          exit (1);
+          fatal_error ();
         }
 
       if (pkg->required_versions == NULL)
@@ -377,6 +1277,184 @@ internal_get_package (const char *name, gboolean warn)
   pkg->requires_private = g_list_reverse (pkg->requires_private);
 
   verify_package (pkg);
+}
+
+static Package *
+internal_get_package (const char *name, gboolean warn)
+{
+  Package *pkg = NULL;
+  char *key = NULL;
+  char *location = NULL;
+  unsigned int path_position = 0;
+  GList *dir_iter;
+  const BundleEntry *entry = NULL;
+  PkgIndexEntry index_entry;
+  gboolean indexed = FALSE;
+  GStatBuf st;
+  gboolean have_st = FALSE;
+  gboolean in_search_dir = FALSE;
+  char *bundle_path = NULL;
+#ifdef G_OS_UNIX
+  int fd = -1;
+#endif
+  
+  pkg = g_hash_table_lookup (packages, name);
+
+  if (pkg)
+    return pkg;
+
+  debug_spew ("Looking for package '%s'\n", name);
+  
+  /* treat "name" as a filename if it ends in .pc and exists */
+  if ( ends_in_dotpc (name) )
+    {
+      debug_spew ("Considering '%s' to be a filename rather than a package name\n", name);
+      location = g_strdup (name);
+      key = g_strdup (name);
+    }
+  else
+    {
+      /* See if we should auto-prefer the uninstalled version */
+      if (!disable_uninstalled &&
+          !name_ends_in_uninstalled (name))
+        {
+          char *un;
+
+          un = g_strconcat (name, "-uninstalled", NULL);
+
+          pkg = internal_get_package (un, FALSE);
+
+          g_free (un);
+          
+          if (pkg)
+            {
+              debug_spew ("Preferring uninstalled version of package '%s'\n", name);
+              return pkg;
+            }
+        }
+      
+      for (dir_iter = search_path_may_contain (name) ? search_dirs : NULL;
+           dir_iter != NULL; dir_iter = g_list_next (dir_iter))
+        {
+          SearchDir *search_dir = dir_iter->data;
+          PkgIndex *pkg_index;
+          gboolean probe;
+          Bundle *bundle;
+
+          path_position = search_dir->position;
+          pkg_index = search_dir_get_pkg_index (search_dir);
+          if (pkg_index != NULL && strchr (name, '/') == NULL &&
+              strchr (name, G_DIR_SEPARATOR) == NULL)
+            {
+              indexed = pkg_index_lookup (pkg_index, name, &index_entry);
+              probe = indexed || !pkg_index_is_exact (pkg_index);
+            }
+          else
+            probe = search_dir_may_contain (search_dir, name);
+
+          if (probe)
+            {
+#ifdef G_OS_UNIX
+              fd = search_dir_open (search_dir, name, &st);
+              if (fd >= 0)
+                {
+                  location = g_strdup_printf ("%s%c%s.pc", search_dir->path,
+                                              G_DIR_SEPARATOR, name);
+                  have_st = TRUE;
+                  in_search_dir = TRUE;
+                  break;
+                }
+#else
+              location = g_strdup_printf ("%s%c%s.pc", search_dir->path,
+                                          G_DIR_SEPARATOR, name);
+              if (g_stat (location, &st) == 0 && S_ISREG (st.st_mode))
+                {
+                  have_st = TRUE;
+                  in_search_dir = TRUE;
+                  break;
+                }
+              g_free (location);
+              location = NULL;
+#endif
+            }
+          indexed = FALSE;
+
+          bundle = search_dir_get_bundle (search_dir);
+          if (bundle != NULL &&
+              (entry = bundle_lookup (bundle, name)) != NULL)
+            {
+              location = g_strdup (entry->path);
+              bundle_path = g_build_filename (search_dir->path,
+                                              BUNDLE_FILENAME, NULL);
+              in_search_dir = TRUE;
+              break;
+            }
+        }
+
+    }
+  
+  if (location == NULL)
+    {
+      if (warn)
+        verbose_error ("Package %s was not found in the pkg-config search path.\n"
+                       "Perhaps you should add the directory containing `%s.pc'\n"
+                       "to the PKG_CONFIG_PATH environment variable\n",
+                       name, name);
+
+      return NULL;
+    }
+
+  if (key == NULL)
+    key = g_strdup (name);
+  else
+    {
+      /* need to strip package name out of the filename */
+      key = g_path_get_basename (name);
+      key[strlen (key) - EXT_LEN] = '\0';
+    }
+
+  debug_spew ("Reading '%s' from file '%s'\n", name, location);
+  if (entry != NULL)
+    pkg = parse_package_buffer (key, location, entry->data, entry->length,
+                                parse_fields);
+  else if (indexed && pkg_index_entry_fresh (&index_entry, &st) &&
+           (parse_fields & ~PKG_INDEX_FIELDS) == 0)
+    {
+#ifdef G_OS_UNIX
+      close (fd);
+#endif
+      pkg = parse_package_buffer (key, location, index_entry.data,
+                                  index_entry.length, parse_fields);
+    }
+#ifdef G_OS_UNIX
+  else if (fd >= 0)
+    pkg = parse_package_fd (key, location, fd, &st, parse_fields);
+#endif
+  else
+    pkg = parse_package_file (key, location, parse_fields);
+  g_free (key);
+
+  if (pkg == NULL)
+    {
+      debug_spew ("Failed to parse '%s'\n", location);
+      g_free (bundle_path);
+      g_free (location);
+      return NULL;
+    }
+
+  /* A name with a directory part is in a subdirectory, which is not
+   * checked for changes */
+  if (strchr (name, '/') != NULL || strchr (name, G_DIR_SEPARATOR) != NULL)
+    in_search_dir = FALSE;
+
+  if (bundle_path != NULL)
+    remember_loaded_file (bundle_path, NULL, TRUE);
+  else
+    remember_loaded_file (location, have_st ? &st : NULL, in_search_dir);
+  g_free (bundle_path);
+
+  add_package (pkg, location, path_position, warn);
+  g_free (location);
 
   return pkg;
 }
@@ -393,6 +1471,20 @@ get_package_quiet (const char *name)
   return internal_get_package (name, FALSE);
 }
 
+Flag *
+flag_new (FlagType type, const char *arg, gsize len)
+{
+  Flag *flag = g_malloc (sizeof (Flag) + len + 1);
+
+  flag->type = type;
+  flag->join = 0;
+  flag->arg = (char *) (flag + 1);
+  memcpy (flag->arg, arg, len);
+  flag->arg[len] = '\0';
+
+  return flag;
+}
+
 /* Strip consecutive duplicate arguments in the flag list. */
 static GList *
 flag_list_strip_duplicates (GList *list)
@@ -406,7 +1498,8 @@ flag_list_strip_duplicates (GList *list)
       Flag *cur = tmp->data;
       Flag *prev = tmp->prev->data;
 
-      if (cur->type == prev->type && g_strcmp0 (cur->arg, prev->arg) == 0)
+      if (cur->type == prev->type && cur->join == prev->join &&
+          g_strcmp0 (cur->arg, prev->arg) == 0)
         {
           /* Remove the duplicate flag from the list and move to the last
            * element to prepare for the next iteration. */
@@ -421,6 +1514,9 @@ flag_list_strip_duplicates (GList *list)
   return list;
 }
 
+/* Format the flags of LIST for a shell, which is the only place their
+ * arguments get escaped.
+ */
 static char *
 flag_list_to_string (GList *list)
 {
@@ -432,25 +1528,31 @@ flag_list_to_string (GList *list)
   while (tmp != NULL) {
     Flag *flag = tmp->data;
     char *tmpstr = flag->arg;
+    char *second = flag->join ? tmpstr + flag->join + 1 : NULL;
+
+    if (second != NULL)
+      {
+        append_escape_shell (str, tmpstr, flag->join);
+        g_string_append_c (str, ' ');
+      }
 
     if (pcsysrootdir != NULL && flag->type & (CFLAGS_I | LIBS_L)) {
       /* Handle non-I Cflags like -isystem */
       if (flag->type & CFLAGS_I && strncmp (tmpstr, "-I", 2) != 0) {
-        char *space = strchr (tmpstr, ' ');
-
         /* Ensure this has a separate arg */
-        g_assert (space != NULL && space[1] != '\0');
-        g_string_append_len (str, tmpstr, space - tmpstr + 1);
+        g_assert (second != NULL && second[0] != '\0');
         g_string_append (str, pcsysrootdir);
-        g_string_append (str, space + 1);
+        append_escape_shell (str, second, strlen (second));
       } else {
         g_string_append_c (str, '-');
         g_string_append_c (str, tmpstr[1]);
         g_string_append (str, pcsysrootdir);
-        g_string_append (str, tmpstr+2);
+        append_escape_shell (str, tmpstr + 2, strlen (tmpstr + 2));
       }
+    } else if (second != NULL) {
+      append_escape_shell (str, second, strlen (second));
     } else {
-      g_string_append (str, tmpstr);
+      append_escape_shell (str, tmpstr, strlen (tmpstr));
     }
     g_string_append_c (str, ' ');
     tmp = g_list_next (tmp);
@@ -541,9 +1643,10 @@ recursive_fill_list (Package *pkg, gboolean include_private,
   *listp = g_list_prepend (*listp, pkg);
 }
 
-/* merge the flags from the individual packages */
+/* merge the flags from the individual packages, including Libs.private
+ * when linking statically */
 static GList *
-merge_flag_lists (GList *packages, FlagType type)
+merge_flag_lists (GList *packages, FlagType type, gboolean static_libs)
 {
   GList *last = NULL;
   GList *merged = NULL;
@@ -552,36 +1655,53 @@ merge_flag_lists (GList *packages, FlagType type)
   for (; packages != NULL; packages = g_list_next (packages))
     {
       Package *pkg = packages->data;
-      GList *flags = (type & LIBS_ANY) ? pkg->libs : pkg->cflags;
-
-      /* manually copy the elements so we can keep track of the end */
-      for (; flags != NULL; flags = g_list_next (flags))
+      GList *lists[2] = { NULL, NULL };
+      GList *flags;
+      int i;
+
+      /* Libs.private is merged in the order the fields came in */
+      if (!(type & LIBS_ANY))
+        lists[0] = pkg->cflags;
+      else if (!static_libs)
+        lists[0] = pkg->libs;
+      else if (pkg->libs_private_first)
         {
-          Flag *flag = flags->data;
-
-          if (flag->type & type)
-            {
-              if (last == NULL)
-                {
-                  merged = g_list_prepend (NULL, flags->data);
-                  last = merged;
-                }
-              else
-                last = g_list_next (g_list_append (last, flags->data));
-            }
+          lists[0] = package_get_libs_private (pkg);
+          lists[1] = pkg->libs;
         }
+      else
+        {
+          lists[0] = pkg->libs;
+          lists[1] = package_get_libs_private (pkg);
+        }
+
+      /* manually copy the elements so we can keep track of the end */
+      for (i = 0; i < 2; i++)
+        for (flags = lists[i]; flags != NULL; flags = g_list_next (flags))
+          {
+            Flag *flag = flags->data;
+
+            if (flag->type & type)
+              {
+                if (last == NULL)
+                  {
+                    merged = g_list_prepend (NULL, flags->data);
+                    last = merged;
+                  }
+                else
+                  last = g_list_next (g_list_append (last, flags->data));
+              }
+          }
     }
 
   return merged;
 }
 
 static GList *
-fill_list (GList *packages, FlagType type,
-           gboolean in_path_order, gboolean include_private)
+fill_list (GList *packages, gboolean include_private)
 {
   GList *tmp;
   GList *expanded = NULL;
-  GList *flags;
   GHashTable *visited;
 
   /* Start from the end of the requested package list to maintain order since
@@ -592,33 +1712,47 @@ fill_list (GList *packages, FlagType type,
   g_hash_table_destroy (visited);
   spew_package_list ("post-recurse", expanded);
 
+  return expanded;
+}
+
+/* Get the list of packages required by PACKAGES from CLOSURES, indexed by
+ * include_private and in_path_order, filling it in on first use. All flag
+ * types requested at once are merged from the same few lists.
+ */
+static GList *
+get_closure (GList *packages, GList *closures[2][2],
+             gboolean include_private, gboolean in_path_order)
+{
+  GList **closure = &closures[include_private ? 1 : 0][in_path_order ? 1 : 0];
+
+  if (*closure != NULL)
+    return *closure;
+
   if (in_path_order)
     {
+      GList *expanded = get_closure (packages, closures, include_private,
+                                     FALSE);
+
       spew_package_list ("original", expanded);
-      expanded = packages_sort_by_path_position (expanded);
-      spew_package_list ("  sorted", expanded);
+      *closure = packages_sort_by_path_position (g_list_copy (expanded));
+      spew_package_list ("  sorted", *closure);
     }
+  else
+    *closure = fill_list (packages, include_private);
 
-  flags = merge_flag_lists (expanded, type);
-  g_list_free (expanded);
-
-  return flags;
+  return *closure;
 }
 
-static GList *
-add_env_variable_to_list (GList *list, const gchar *env)
+static void
+add_env_variable_to_set (GHashTable *set, const gchar *env)
 {
   gchar **values;
   gint i;
 
   values = g_strsplit (env, G_SEARCHPATH_SEPARATOR_S, 0);
   for (i = 0; values[i] != NULL; i++)
-    {
-      list = g_list_append (list, g_strdup (values[i]));
-    }
-  g_strfreev (values);
-
-  return list;
+    g_hash_table_add (set, values[i]);
+  g_free (values);
 }
 
 /* Well known compiler include path environment variables. These are
@@ -640,21 +1774,116 @@ static const gchar *msvc_include_envvars[] = {
 };
 #endif
 
+/* The system directories that compilers expect, whose -I and -L flags
+ * are removed. They only depend on the environment, so they are looked
+ * up once for all packages.
+ */
+static GHashTable *system_include_dirs = NULL;
+static GHashTable *system_lib_dirs = NULL;
+static gboolean allow_system_cflags = FALSE;
+static gboolean allow_system_libs = FALSE;
+
+static void
+init_system_dirs (void)
+{
+  const gchar *search_path;
+  const gchar **include_envvars;
+  const gchar **var;
+
+  if (system_include_dirs != NULL)
+    return;
+
+  system_include_dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, NULL);
+
+  search_path = g_getenv ("PKG_CONFIG_SYSTEM_INCLUDE_PATH");
+
+  if (search_path == NULL)
+    {
+      search_path = PKG_CONFIG_SYSTEM_INCLUDE_PATH;
+    }
+
+  add_env_variable_to_set (system_include_dirs, search_path);
+
+#ifdef G_OS_WIN32
+  include_envvars = msvc_syntax ? msvc_include_envvars : gcc_include_envvars;
+#else
+  include_envvars = gcc_include_envvars;
+#endif
+  for (var = include_envvars; *var != NULL; var++)
+    {
+      search_path = g_getenv (*var);
+      if (search_path != NULL)
+        add_env_variable_to_set (system_include_dirs, search_path);
+    }
+
+  system_lib_dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, NULL);
+
+  search_path = g_getenv ("PKG_CONFIG_SYSTEM_LIBRARY_PATH");
+
+  if (search_path == NULL)
+    {
+      search_path = PKG_CONFIG_SYSTEM_LIBRARY_PATH;
+    }
+
+  add_env_variable_to_set (system_lib_dirs, search_path);
+
+  allow_system_cflags = g_getenv ("PKG_CONFIG_ALLOW_SYSTEM_CFLAGS") != NULL;
+  allow_system_libs = g_getenv ("PKG_CONFIG_ALLOW_SYSTEM_LIBS") != NULL;
+}
+
+/* Remove the -L flags for the system library directories from LIBS,
+ * which come from the FIELD of PKG, unless they are allowed.
+ */
+static GList *
+strip_system_libdirs (Package *pkg, GList *libs, const char *field)
+{
+  GList *iter = libs;
+
+  while (iter != NULL)
+    {
+      GList *next = g_list_next (iter);
+      Flag *flag = iter->data;
+      const char *system_libpath = NULL;
+
+      if (flag->type & LIBS_L)
+        {
+          if (strncmp (flag->arg, "-L ", 3) == 0 &&
+              g_hash_table_contains (system_lib_dirs, flag->arg + 3))
+            system_libpath = flag->arg + 3;
+          else if (strncmp (flag->arg, "-L", 2) == 0 &&
+                   g_hash_table_contains (system_lib_dirs, flag->arg + 2))
+            system_libpath = flag->arg + 2;
+        }
+
+      if (system_libpath != NULL)
+        {
+          debug_spew ("Package %s has -L %s in %s\n",
+                      pkg->key, system_libpath, field);
+          if (!allow_system_libs)
+            {
+              debug_spew ("Removing -L %s from libs for %s\n",
+                          system_libpath, pkg->key);
+              libs = g_list_delete_link (libs, iter);
+            }
+        }
+
+      iter = next;
+    }
+
+  return libs;
+}
+
 static void
 verify_package (Package *pkg)
 {
   GList *requires = NULL;
   GList *conflicts = NULL;
-  GList *system_directories = NULL;
   GList *iter;
   GList *requires_iter;
   GList *conflicts_iter;
-  GList *system_dir_iter = NULL;
   GHashTable *visited;
-  int count;
-  const gchar *search_path;
-  const gchar **include_envvars;
-  const gchar **var;
 
   /* Be sure we have the required fields */
 
@@ -662,28 +1891,28 @@ verify_package (Package *pkg)
     {
       fprintf (stderr,
                "Internal pkg-config error, package with no key, please file a bug report\n");
-      exit (1);
+      fatal_error ();
     }
   
   if (pkg->name == NULL)
     {
       verbose_error ("Package '%s' has no Name: field\n",
                      pkg->key);
-      exit (1);
+      fatal_error ();
     }
 
   if (pkg->version == NULL)
     {
       verbose_error ("Package '%s' has no Version: field\n",
                      pkg->key);
-      exit (1);
+      fatal_error ();
     }
 
   if (pkg->description == NULL)
     {
       verbose_error ("Package '%s' has no Description: field\n",
                      pkg->key);
-      exit (1);
+      fatal_error ();
     }
   
   /* Make sure we have the right version for all requirements */
@@ -713,194 +1942,110 @@ verify_package (Package *pkg)
                 verbose_error ("You may find new versions of %s at %s\n",
                                req->name, req->url);
 
-              exit (1);
+              fatal_error ();
             }
         }
                                    
       iter = g_list_next (iter);
     }
 
-  /* Make sure we didn't drag in any conflicts via Requires
-   * (inefficient algorithm, who cares)
+  /* Make sure we didn't drag in any conflicts via Requires. Only this
+   * package's own Conflicts are checked, and hardly any package declares
+   * some, so don't walk the requires chain for nothing.
    */
-  visited = g_hash_table_new (g_str_hash, g_str_equal);
-  recursive_fill_list (pkg, TRUE, visited, &requires);
-  g_hash_table_destroy (visited);
   conflicts = pkg->conflicts;
-
-  requires_iter = requires;
-  while (requires_iter != NULL)
+  if (conflicts != NULL)
     {
-      Package *req = requires_iter->data;
-      
-      conflicts_iter = conflicts;
+      visited = g_hash_table_new (g_str_hash, g_str_equal);
+      recursive_fill_list (pkg, TRUE, visited, &requires);
+      g_hash_table_destroy (visited);
 
-      while (conflicts_iter != NULL)
+      requires_iter = requires;
+      while (requires_iter != NULL)
         {
-          RequiredVersion *ver = conflicts_iter->data;
+          Package *req = requires_iter->data;
 
-	  if (strcmp (ver->name, req->key) == 0 &&
-	      version_test (ver->comparison,
-			    req->version,
-			    ver->version))
+          conflicts_iter = conflicts;
+
+          while (conflicts_iter != NULL)
             {
-              verbose_error ("Version %s of %s creates a conflict.\n"
-                             "(%s %s %s conflicts with %s %s)\n",
-                             req->version, req->key,
-                             ver->name,
-                             comparison_to_str (ver->comparison),
-                             ver->version ? ver->version : "(any)",
-                             ver->owner->key,
-                             ver->owner->version);
+              RequiredVersion *ver = conflicts_iter->data;
+
+              if (strcmp (ver->name, req->key) == 0 &&
+                  version_test (ver->comparison,
+                                req->version,
+                                ver->version))
+                {
+                  verbose_error ("Version %s of %s creates a conflict.\n"
+                                 "(%s %s %s conflicts with %s %s)\n",
+                                 req->version, req->key,
+                                 ver->name,
+                                 comparison_to_str (ver->comparison),
+                                 ver->version ? ver->version : "(any)",
+                                 ver->owner->key,
+                                 ver->owner->version);
+
+                  fatal_error ();
+                }
 
-              exit (1);
+              conflicts_iter = g_list_next (conflicts_iter);
             }
 
-          conflicts_iter = g_list_next (conflicts_iter);
+          requires_iter = g_list_next (requires_iter);
         }
-      
-      requires_iter = g_list_next (requires_iter);
-    }
-  
-  g_list_free (requires);
 
-  /* We make a list of system directories that compilers expect so we
-   * can remove them.
-   */
-
-  search_path = g_getenv ("PKG_CONFIG_SYSTEM_INCLUDE_PATH");
-
-  if (search_path == NULL)
-    {
-      search_path = PKG_CONFIG_SYSTEM_INCLUDE_PATH;
+      g_list_free (requires);
     }
 
-  system_directories = add_env_variable_to_list (system_directories, search_path);
-
-#ifdef G_OS_WIN32
-  include_envvars = msvc_syntax ? msvc_include_envvars : gcc_include_envvars;
-#else
-  include_envvars = gcc_include_envvars;
-#endif
-  for (var = include_envvars; *var != NULL; var++)
-    {
-      search_path = g_getenv (*var);
-      if (search_path != NULL)
-        system_directories = add_env_variable_to_list (system_directories, search_path);
-    }
+  /* Remove the system directories that compilers expect */
+  init_system_dirs ();
 
-  count = 0;
-  for (iter = pkg->cflags; iter != NULL; iter = g_list_next (iter))
+  iter = pkg->cflags;
+  while (iter != NULL)
     {
-      gint offset = 0;
+      GList *next = g_list_next (iter);
       Flag *flag = iter->data;
 
-      if (!(flag->type & CFLAGS_I))
-        continue;
-
       /* Handle the system cflags. We put things in canonical
-       * -I/usr/include (vs. -I /usr/include) format, but if someone
-       * changes it later we may as well be robust.
+       * -I/usr/include (vs. -I /usr/include) format.
        *
        * Note that the -i* flags are left out of this handling since
        * they're intended to adjust the system cflags behavior.
        */
-      if (((strncmp (flag->arg, "-I", 2) == 0) && (offset = 2))||
-          ((strncmp (flag->arg, "-I ", 3) == 0) && (offset = 3)))
+      if ((flag->type & CFLAGS_I) &&
+          strncmp (flag->arg, "-I", 2) == 0 &&
+          g_hash_table_contains (system_include_dirs, flag->arg + 2))
         {
-	  if (offset == 0)
-	    {
-	      iter = iter->next;
-	      continue;
-	    }
-
-	  system_dir_iter = system_directories;
-	  while (system_dir_iter != NULL)
-	    {
-	      if (strcmp (system_dir_iter->data,
-                          ((char*)flag->arg) + offset) == 0)
-		{
-                  debug_spew ("Package %s has %s in Cflags\n",
-			      pkg->key, (gchar *)flag->arg);
-		  if (g_getenv ("PKG_CONFIG_ALLOW_SYSTEM_CFLAGS") == NULL)
-		    {
-                      debug_spew ("Removing %s from cflags for %s\n",
-                                  flag->arg, pkg->key);
-		      ++count;
-		      iter->data = NULL;
-
-		      break;
-		    }
-		}
-	      system_dir_iter = system_dir_iter->next;
-	    }
+          debug_spew ("Package %s has %s in Cflags\n",
+                      pkg->key, flag->arg);
+          if (!allow_system_cflags)
+            {
+              debug_spew ("Removing %s from cflags for %s\n",
+                          flag->arg, pkg->key);
+              pkg->cflags = g_list_delete_link (pkg->cflags, iter);
+            }
         }
-    }
 
-  while (count)
-    {
-      pkg->cflags = g_list_remove (pkg->cflags, NULL);
-      --count;
-    }
-
-  g_list_foreach (system_directories, (GFunc) g_free, NULL);
-  g_list_free (system_directories);
-
-  system_directories = NULL;
-
-  search_path = g_getenv ("PKG_CONFIG_SYSTEM_LIBRARY_PATH");
-
-  if (search_path == NULL)
-    {
-      search_path = PKG_CONFIG_SYSTEM_LIBRARY_PATH;
+      iter = next;
     }
 
-  system_directories = add_env_variable_to_list (system_directories, search_path);
+  pkg->libs = strip_system_libdirs (pkg, pkg->libs, "Libs");
+}
 
-  count = 0;
-  for (iter = pkg->libs; iter != NULL; iter = g_list_next (iter))
+/* Get the flags in Libs.private of PKG, splitting the field the first
+ * time.
+ */
+GList *
+package_get_libs_private (Package *pkg)
+{
+  if (pkg->libs_private_field != NULL)
     {
-      GList *system_dir_iter = system_directories;
-      Flag *flag = iter->data;
-
-      if (!(flag->type & LIBS_L))
-        continue;
-
-      while (system_dir_iter != NULL)
-        {
-          gboolean is_system = FALSE;
-          const char *linker_arg = flag->arg;
-          const char *system_libpath = system_dir_iter->data;
-
-          if (strncmp (linker_arg, "-L ", 3) == 0 &&
-              strcmp (linker_arg + 3, system_libpath) == 0)
-            is_system = TRUE;
-          else if (strncmp (linker_arg, "-L", 2) == 0 &&
-              strcmp (linker_arg + 2, system_libpath) == 0)
-            is_system = TRUE;
-          if (is_system)
-            {
-              debug_spew ("Package %s has -L %s in Libs\n",
-                          pkg->key, system_libpath);
-              if (g_getenv ("PKG_CONFIG_ALLOW_SYSTEM_LIBS") == NULL)
-                {
-                  iter->data = NULL;
-                  ++count;
-                  debug_spew ("Removing -L %s from libs for %s\n",
-                              system_libpath, pkg->key);
-                  break;
-                }
-            }
-          system_dir_iter = system_dir_iter->next;
-        }
+      parse_package_libs_private (pkg);
+      pkg->libs_private = strip_system_libdirs (pkg, pkg->libs_private,
+                                                "Libs.private");
     }
-  g_list_free (system_directories);
 
-  while (count)
-    {
-      pkg->libs = g_list_remove (pkg->libs, NULL);
-      --count;
-    }
+  return pkg->libs_private;
 }
 
 /* Create a merged list of required packages and retrieve the flags from them.
@@ -911,13 +2056,15 @@ verify_package (Package *pkg)
  * The former is done for -I/-L flags, and the latter for all others.
  */
 static char *
-get_multi_merged (GList *pkgs, FlagType type, gboolean in_path_order,
-                  gboolean include_private)
+get_multi_merged (GList *pkgs, GList *closures[2][2], FlagType type,
+                  gboolean in_path_order, gboolean include_private)
 {
   GList *list;
   char *retval;
 
-  list = fill_list (pkgs, type, in_path_order, include_private);
+  list = merge_flag_lists (get_closure (pkgs, closures, include_private,
+                                        in_path_order),
+                           type, include_private);
   list = flag_list_strip_duplicates (list);
   retval = flag_list_to_string (list);
   g_list_free (list);
@@ -926,44 +2073,50 @@ get_multi_merged (GList *pkgs, FlagType type, gboolean in_path_order,
 }
 
 char *
-packages_get_flags (GList *pkgs, FlagType flags)
+packages_get_flags (GList *pkgs, FlagType flags, gboolean static_libs)
 {
   GString *str;
   char *cur;
+  GList *closures[2][2] = { { NULL, NULL }, { NULL, NULL } };
+  int i, j;
 
   str = g_string_new (NULL);
 
   /* sort packages in path order for -L/-I, dependency order otherwise */
   if (flags & CFLAGS_OTHER)
     {
-      cur = get_multi_merged (pkgs, CFLAGS_OTHER, FALSE, TRUE);
+      cur = get_multi_merged (pkgs, closures, CFLAGS_OTHER, FALSE, TRUE);
       debug_spew ("adding CFLAGS_OTHER string \"%s\"\n", cur);
       g_string_append (str, cur);
       g_free (cur);
     }
   if (flags & CFLAGS_I)
     {
-      cur = get_multi_merged (pkgs, CFLAGS_I, TRUE, TRUE);
+      cur = get_multi_merged (pkgs, closures, CFLAGS_I, TRUE, TRUE);
       debug_spew ("adding CFLAGS_I string \"%s\"\n", cur);
       g_string_append (str, cur);
       g_free (cur);
     }
   if (flags & LIBS_L)
     {
-      cur = get_multi_merged (pkgs, LIBS_L, TRUE, !ignore_private_libs);
+      cur = get_multi_merged (pkgs, closures, LIBS_L, TRUE, static_libs);
       debug_spew ("adding LIBS_L string \"%s\"\n", cur);
       g_string_append (str, cur);
       g_free (cur);
     }
   if (flags & (LIBS_OTHER | LIBS_l))
     {
-      cur = get_multi_merged (pkgs, flags & (LIBS_OTHER | LIBS_l), FALSE,
-                              !ignore_private_libs);
+      cur = get_multi_merged (pkgs, closures, flags & (LIBS_OTHER | LIBS_l),
+                              FALSE, static_libs);
       debug_spew ("adding LIBS_OTHER | LIBS_l string \"%s\"\n", cur);
       g_string_append (str, cur);
       g_free (cur);
     }
 
+  for (i = 0; i < 2; i++)
+    for (j = 0; j < 2; j++)
+      g_list_free (closures[i][j]);
+
   /* Strip trailing space. */
   if (str->len > 0 && str->str[str->len - 1] == ' ')
     g_string_truncate (str, str->len - 1);
@@ -982,7 +2135,7 @@ define_global_variable (const char *varname,
   if (g_hash_table_lookup (globals, varname))
     {
       verbose_error ("Variable '%s' defined twice globally\n", varname);
-      exit (1);
+      fatal_error ();
     }
   
   g_hash_table_insert (globals, g_strdup (varname), g_strdup (varval));
@@ -991,55 +2144,200 @@ define_global_variable (const char *varname,
               varname, varval);
 }
 
-char *
-var_to_env_var (const char *pkg, const char *var)
+#define ENV_VAR_PREFIX "PKG_CONFIG_"
+#define ENV_VAR_PREFIX_LEN 11
+
+/* Override names at least this long are not in env_override_lengths */
+#define MAX_ENV_OVERRIDE_LEN 256
+
+/* Environment variables of the form PKG_CONFIG_$PACKAGENAME_$VARIABLE,
+ * read once, and a bitmap of the lengths of their names, so that most
+ * lookups are settled without even building the name.
+ */
+static GHashTable *env_overrides = NULL;
+static guint32 env_override_lengths[MAX_ENV_OVERRIDE_LEN / 32];
+static gboolean env_override_long = FALSE;
+
+static void
+init_env_overrides (void)
 {
-  char *new = g_strconcat ("PKG_CONFIG_", pkg, "_", var, NULL);
-  char *p;
-  for (p = new; *p != 0; p++)
+  static gsize initialized = 0;
+  gchar **names;
+  gchar **iter;
+
+  if (!g_once_init_enter (&initialized))
+    return;
+
+  env_overrides = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         g_free, g_free);
+
+  names = g_listenv ();
+  for (iter = names; *iter != NULL; iter++)
     {
-      char c = g_ascii_toupper (*p);
+      const char *value;
+      char *name;
+      gsize len;
+
+#ifdef G_OS_WIN32
+      /* The environment is case insensitive */
+      name = g_ascii_strup (*iter, -1);
+#else
+      name = g_strdup (*iter);
+#endif
+      len = strlen (name);
+
+      /* There has to be a package and a variable name after the prefix */
+      value = g_getenv (*iter);
+      if (value == NULL ||
+          strncmp (name, ENV_VAR_PREFIX, ENV_VAR_PREFIX_LEN) != 0 ||
+          len < ENV_VAR_PREFIX_LEN + 3 ||
+          strchr (name + ENV_VAR_PREFIX_LEN + 1, '_') == NULL)
+        {
+          g_free (name);
+          continue;
+        }
 
-      if (!g_ascii_isalnum (c))
-        c = '_';
+      if (len < MAX_ENV_OVERRIDE_LEN)
+        env_override_lengths[len / 32] |= 1U << (len % 32);
+      else
+        env_override_long = TRUE;
 
-      *p = c;
+      g_hash_table_insert (env_overrides, name, g_strdup (value));
     }
+  g_strfreev (names);
 
-  return new;
+  g_once_init_leave (&initialized, 1);
 }
 
-char *
-package_get_var (Package *pkg,
-                 const char *var)
+/* Write the name of the environment variable overriding VAR of package
+ * PKG into NAME, which has to have room for it.
+ */
+static void
+var_to_env_var (const char *pkg, const char *var, char *name)
+{
+  const char *parts[] = { pkg, "_", var, NULL };
+  const char **part;
+  const char *q;
+  char *p;
+
+  strcpy (name, ENV_VAR_PREFIX);
+  p = name + ENV_VAR_PREFIX_LEN;
+  for (part = parts; *part != NULL; part++)
+    for (q = *part; *q != '\0'; q++)
+      {
+        char c = g_ascii_toupper (*q);
+
+        if (!g_ascii_isalnum (c))
+          c = '_';
+
+        *p++ = c;
+      }
+  *p = '\0';
+}
+
+static const char *
+lookup_env_override (const char *pkg, const char *var)
+{
+  char buf[MAX_ENV_OVERRIDE_LEN];
+  char *name;
+  const char *value;
+  gsize len;
+
+  init_env_overrides ();
+  if (g_hash_table_size (env_overrides) == 0)
+    return NULL;
+
+  len = ENV_VAR_PREFIX_LEN + strlen (pkg) + 1 + strlen (var);
+  if (len < MAX_ENV_OVERRIDE_LEN)
+    {
+      if ((env_override_lengths[len / 32] & (1U << (len % 32))) == 0)
+        return NULL;
+      name = buf;
+    }
+  else
+    {
+      if (!env_override_long)
+        return NULL;
+      name = g_malloc (len + 1);
+    }
+
+  var_to_env_var (pkg, var, name);
+  value = g_hash_table_lookup (env_overrides, name);
+
+  if (name != buf)
+    g_free (name);
+
+  return value;
+}
+
+static const char *
+peek_external_var (Package *pkg,
+                   const char *var)
 {
-  char *varval = NULL;
+  const char *varval = NULL;
 
   if (globals)
-    varval = g_strdup (g_hash_table_lookup (globals, var));
+    varval = g_hash_table_lookup (globals, var);
 
   /* Allow overriding specific variables using an environment variable of the
    * form PKG_CONFIG_$PACKAGENAME_$VARIABLE
    */
   if (pkg->key)
     {
-      char *env_var = var_to_env_var (pkg->key, var);
-      const char *env_var_content = g_getenv (env_var);
-      g_free (env_var);
+      const char *env_var_content = lookup_env_override (pkg->key, var);
       if (env_var_content)
         {
           debug_spew ("Overriding variable '%s' from environment\n", var);
-          return g_strdup (env_var_content);
+          return env_var_content;
         }
     }
 
+  return varval;
+}
+
+char *
+package_get_external_var (Package *pkg,
+                          const char *var)
+{
+  return g_strdup (peek_external_var (pkg, var));
+}
+
+/* Like package_get_var(), but the value is not copied, and stays owned by
+ * PKG or the global variables.
+ */
+const char *
+package_peek_var (Package *pkg,
+                  const char *var)
+{
+  const char *varval = peek_external_var (pkg, var);
 
   if (varval == NULL && pkg->vars)
-    varval = g_strdup (g_hash_table_lookup (pkg->vars, var));
+    varval = expand_package_var (pkg, var);
 
   return varval;
 }
 
+char *
+package_get_var (Package *pkg,
+                 const char *var)
+{
+  return g_strdup (package_peek_var (pkg, var));
+}
+
+/* Like package_get_var() != NULL, without expanding anything */
+gboolean
+package_has_var (Package *pkg,
+                 const char *var)
+{
+  if (globals && g_hash_table_lookup (globals, var) != NULL)
+    return TRUE;
+
+  if (pkg->key && lookup_env_override (pkg->key, var) != NULL)
+    return TRUE;
+
+  return pkg->vars && g_hash_table_lookup (pkg->vars, var) != NULL;
+}
+
 char *
 packages_get_var (GList      *pkgs,
                   const char *varname)
@@ -1187,45 +2485,6 @@ print_package_list (void)
 {
   int mlen = 0;
 
-  ignore_requires = TRUE;
-  ignore_requires_private = TRUE;
-
   g_hash_table_foreach (packages, max_len_foreach, &mlen);
   g_hash_table_foreach (packages, packages_foreach, GINT_TO_POINTER (mlen + 1));
 }
-
-void
-enable_private_libs(void)
-{
-  ignore_private_libs = FALSE;
-}
-
-void
-disable_private_libs(void)
-{
-  ignore_private_libs = TRUE;
-}
-
-void
-enable_requires(void)
-{
-  ignore_requires = FALSE;
-}
-
-void
-disable_requires(void)
-{
-  ignore_requires = TRUE;
-}
-
-void
-enable_requires_private(void)
-{
-  ignore_requires_private = FALSE;
-}
-
-void
-disable_requires_private(void)
-{
-  ignore_requires_private = TRUE;
-}
@@ -34,6 +34,21 @@ typedef guint8 FlagType; /* bit mask for flag types */
 #define CFLAGS_ANY   (CFLAGS_I | CFLAGS_OTHER)
 #define FLAGS_ANY    (LIBS_ANY | CFLAGS_ANY)
 
+typedef guint8 FieldMask; /* bit mask for .pc file fields */
+
+/* Fields that are only parsed when they are needed. Name, Description,
+ * Version, URL and the variables are always parsed. Libs.private is
+ * read along with Libs, but only split by package_get_libs_private().
+ */
+#define FIELD_REQUIRES         (1 << 0)
+#define FIELD_REQUIRES_PRIVATE (1 << 1)
+#define FIELD_CONFLICTS        (1 << 2)
+#define FIELD_LIBS             (1 << 3)
+#define FIELD_CFLAGS           (1 << 4)
+
+#define FIELDS_ALL   (FIELD_REQUIRES | FIELD_REQUIRES_PRIVATE | \
+                      FIELD_CONFLICTS | FIELD_LIBS | FIELD_CFLAGS)
+
 typedef enum
 {
   LESS_THAN,
@@ -52,7 +67,13 @@ typedef struct RequiredVersion_ RequiredVersion;
 struct Flag_
 {
   FlagType type;
+  /* The argument as the compiler sees it, without shell escaping */
   char *arg;
+  /* Options with a separate argument, like "-framework Foo", are kept in
+   * one flag. JOIN is then the offset of the space between the two,
+   * otherwise 0.
+   */
+  gsize join;
 };
 
 struct RequiredVersion_
@@ -71,34 +92,68 @@ struct Package_
   char *description;
   char *url;
   char *pcfiledir; /* directory it was loaded from */
+  char *path; /* file it was loaded from */
   GList *requires_entries;
   GList *requires;
   GList *requires_private_entries;
   GList *requires_private;
   GList *libs;
+  GList *libs_private; /* see package_get_libs_private() */
+  char *libs_private_field; /* Libs.private as written, until it is split */
   GList *cflags;
   GHashTable *vars;
+  GHashTable *unexpanded_vars; /* vars still holding their raw value */
   GHashTable *required_versions; /* hash from name to RequiredVersion */
   GList *conflicts; /* list of RequiredVersion */
   gboolean uninstalled; /* used the -uninstalled file */
   int path_position; /* used to order packages by position in path of their .pc file, lower number means earlier in path */
   int libs_num; /* Number of times the "Libs" header has been seen */
   int libs_private_num;  /* Number of times the "Libs.private" header has been seen */
+  gboolean libs_private_first; /* "Libs.private" came before "Libs" */
   char *orig_prefix; /* original prefix value before redefinition */
 };
 
 Package *get_package               (const char *name);
 Package *get_package_quiet         (const char *name);
+GList *  package_get_requires_private (Package *pkg);
+GList *  package_get_libs_private  (Package    *pkg);
+void     package_load_requires_private (Package *pkg);
 char *   packages_get_flags        (GList      *pkgs,
-                                    FlagType   flags);
+                                    FlagType   flags,
+                                    gboolean   static_libs);
 char *   package_get_var           (Package    *pkg,
                                     const char *var);
+char *   package_get_external_var  (Package    *pkg,
+                                    const char *var);
+const char *package_peek_var       (Package    *pkg,
+                                    const char *var);
+gboolean package_has_var           (Package    *pkg,
+                                    const char *var);
 char *   packages_get_var          (GList      *pkgs,
                                     const char *var);
 
+/* Allocate a flag with a copy of the LEN bytes at ARG in the same block,
+ * so that freeing the flag frees its argument too.
+ */
+Flag *   flag_new                  (FlagType    type,
+                                    const char *arg,
+                                    gsize       len);
+
 void add_search_dir (const char *path);
 void add_search_dirs (const char *path, const char *separator);
+/* Drop the directories that do not exist or were already added under
+ * another name from the search path, as they could only be probed in
+ * vain.
+ */
+void resolve_search_dirs (void);
+/* Paths of the directories in the search path, in order. Free the list
+ * but not the paths.
+ */
+GList *get_search_dir_paths (void);
 void package_init (gboolean want_list);
+void package_reset (void);
+/* Free PKG, which no other package may refer to any more. */
+void package_free (Package *pkg);
 int compare_versions (const char * a, const char *b);
 gboolean version_test (ComparisonType comparison,
                        const char *a,
@@ -114,14 +169,31 @@ void define_global_variable (const char *varname,
 void debug_spew (const char *format, ...);
 void verbose_error (const char *format, ...);
 
+/* Append the messages of the calling thread to BUFFER instead of printing
+ * them, until it is set back to NULL. print_messages() prints them.
+ */
+void collect_messages (GString *buffer);
+void print_messages (const GString *buffer);
+
+/* Give up after an error has been reported. This exits, unless answering
+ * a --batch query, in which case it longjmp()s back to the query loop and
+ * only that query fails. So while a query runs, it must only be called
+ * from the main thread and never from within a glib callback: --list-all
+ * parses non-strictly so its thread pool workers never get here, and
+ * --define-variable, whose option callback may, is not a query option.
+ * Nor may the caller hold anything that package_reset () does not free.
+ */
+void fatal_error (void) G_GNUC_NORETURN;
+
+/* Number of calls to verbose_error () made by the calling thread,
+ * whether or not they printed.
+ */
+guint verbose_error_count (void);
+
 gboolean name_ends_in_uninstalled (const char *str);
 
-void enable_private_libs(void);
-void disable_private_libs(void);
-void enable_requires(void);
-void disable_requires(void);
-void enable_requires_private(void);
-void disable_requires_private(void);
+/* Fields of the .pc files to parse, see FIELD_REQUIRES and friends */
+extern FieldMask parse_fields;
 
 /* If TRUE, do not automatically prefer uninstalled versions */
 extern gboolean disable_uninstalled;
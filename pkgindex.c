@@ -0,0 +1,740 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "pkgindex.h"
+#include "cache.h"
+#include "parse.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* The index of a directory is written next to it, as <dir>.index, since
+ * writing it into the directory would change the mtime it is checked
+ * against. It is a binary file in native byte order, meant to be mapped
+ * and used in place:
+ *
+ *   header   see IndexHeader
+ *   buckets  displacement of each bucket of the perfect hash
+ *   slots    offset of the entry in each slot
+ *   entries  an IndexRecord, then the key and the data, each followed
+ *            by a nul byte, padded to 8 bytes
+ *
+ * A name is hashed with a seed of 0 to pick its bucket, then with the
+ * displacement of the bucket to pick its slot. The entry in that slot
+ * is either the package of that name or, if there is no such package,
+ * some other one.
+ */
+#define INDEX_SUFFIX ".index"
+/* Set in the flags of the header if a name that is not in the index
+ * surely has no .pc file, see dir_names_exact().
+ */
+#define INDEX_FLAG_EXACT 1
+#define INDEX_BYTE_ORDER 0x01020304
+
+static const char index_magic[24] = "pkg-config index 2\n";
+
+typedef struct
+{
+  char magic[24];
+  guint32 byte_order;
+  guint32 n_entries;
+  guint32 n_buckets;
+  guint32 flags;
+  guint64 dir_mtime;
+  guint64 dir_dev;
+  guint64 dir_ino;
+} IndexHeader;
+
+/* Status of the .pc file when it was indexed */
+typedef struct
+{
+  guint64 mtime;
+  guint64 ctime;
+  guint64 size;
+  guint64 dev;
+  guint64 ino;
+  guint32 key_len;
+  guint32 data_len;
+  guint32 racy; /* whether it could change without its status changing */
+  guint32 reserved;
+} IndexRecord;
+
+/* Displacements tried for a bucket before giving up on the number of
+ * buckets.
+ */
+#define MAX_DISPLACEMENT (1 << 20)
+
+#define PAD8(n) (((n) + 7) & ~(gsize) 7)
+
+#ifdef G_OS_WIN32
+/* Guard against .pc file being installed with UPPER CASE name */
+# define FOLD(x) g_ascii_tolower (x)
+# define KEYNCMP(a, b, n) g_ascii_strncasecmp (a, b, n)
+#else
+# define FOLD(x) (x)
+# define KEYNCMP(a, b, n) strncmp (a, b, n)
+#endif
+
+#define EXT_LEN 3
+
+struct PkgIndex_
+{
+  GMappedFile *file;
+  const char *data;
+  gsize length;
+  const IndexHeader *header;
+  const guint32 *buckets;
+  const guint32 *slots;
+};
+
+static guint32
+index_hash (const char *key, gsize len, guint32 seed)
+{
+  guint32 h = 2166136261u ^ (seed * 0x9e3779b9u);
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    {
+      h ^= (guchar) FOLD (key[i]);
+      h *= 16777619u;
+    }
+
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+
+  return h;
+}
+
+/* Where the index of DIRNAME goes, or NULL if it has no parent to put
+ * it in.
+ */
+static char *
+index_path (const char *dirname)
+{
+  gsize len = strlen (dirname);
+
+  while (len > 0 && G_IS_DIR_SEPARATOR (dirname[len - 1]))
+    len--;
+  if (len == 0)
+    return NULL;
+
+  return g_strdup_printf ("%.*s" INDEX_SUFFIX, (int) len, dirname);
+}
+
+void
+pkg_index_free (PkgIndex *index)
+{
+  g_mapped_file_unref (index->file);
+  g_free (index);
+}
+
+/* Map the index at PATH, whether or not it is up to date. */
+static PkgIndex *
+index_open (const char *path)
+{
+  PkgIndex *index;
+  GMappedFile *file;
+  const IndexHeader *header;
+  guint64 tables;
+
+  file = g_mapped_file_new (path, FALSE, NULL);
+  if (file == NULL)
+    return NULL;
+
+  index = g_new0 (PkgIndex, 1);
+  index->file = file;
+  index->data = g_mapped_file_get_contents (file);
+  index->length = g_mapped_file_get_length (file);
+
+  header = (const IndexHeader *) index->data;
+  if (index->length < sizeof (IndexHeader) ||
+      memcmp (header->magic, index_magic, sizeof (index_magic)) != 0 ||
+      header->byte_order != INDEX_BYTE_ORDER ||
+      header->n_buckets == 0)
+    {
+      debug_spew ("Ignoring invalid package index '%s'\n", path);
+      pkg_index_free (index);
+      return NULL;
+    }
+
+  tables = sizeof (IndexHeader) +
+           4 * ((guint64) header->n_buckets + header->n_entries);
+  if (tables > index->length)
+    {
+      debug_spew ("Ignoring truncated package index '%s'\n", path);
+      pkg_index_free (index);
+      return NULL;
+    }
+
+  index->header = header;
+  index->buckets = (const guint32 *) (header + 1);
+  index->slots = index->buckets + header->n_buckets;
+
+  return index;
+}
+
+/* Read the entry at OFFSET, checking that it lies within the index. */
+static const IndexRecord *
+index_read_record (PkgIndex *index, guint32 offset, PkgIndexEntry *entry)
+{
+  const IndexRecord *record;
+  const char *key;
+  gsize avail;
+
+  if (offset % 8 != 0 || offset > index->length ||
+      index->length - offset < sizeof (IndexRecord))
+    return NULL;
+
+  record = (const IndexRecord *) (index->data + offset);
+  avail = index->length - offset - sizeof (IndexRecord);
+  if ((guint64) record->key_len + record->data_len + 2 > avail)
+    return NULL;
+
+  key = (const char *) (record + 1);
+  if (key[record->key_len] != '\0' ||
+      key[record->key_len + 1 + record->data_len] != '\0')
+    return NULL;
+
+  entry->key = key;
+  entry->data = key + record->key_len + 1;
+  entry->length = record->data_len;
+  entry->mtime = record->mtime;
+  entry->ctime = record->ctime;
+  entry->size = record->size;
+  entry->dev = record->dev;
+  entry->ino = record->ino;
+  entry->racy = record->racy != 0;
+
+  return record;
+}
+
+PkgIndex *
+pkg_index_load (const char *dirname)
+{
+  PkgIndex *index;
+  GStatBuf st;
+  char *path;
+
+  path = index_path (dirname);
+  if (path == NULL)
+    return NULL;
+
+  index = index_open (path);
+  if (index == NULL)
+    {
+      g_free (path);
+      return NULL;
+    }
+
+  if (g_stat (dirname, &st) != 0 ||
+      index->header->dir_mtime != (guint64) st.st_mtime ||
+      index->header->dir_dev != (guint64) st.st_dev ||
+      index->header->dir_ino != (guint64) st.st_ino)
+    {
+      debug_spew ("Ignoring package index '%s', the directory changed "
+                  "since it was built\n", path);
+      pkg_index_free (index);
+      g_free (path);
+      return NULL;
+    }
+
+  debug_spew ("Using package index '%s' with %u packages\n", path,
+              index->header->n_entries);
+  g_free (path);
+
+  return index;
+}
+
+gboolean
+pkg_index_lookup (PkgIndex *index, const char *name, PkgIndexEntry *entry)
+{
+  const IndexRecord *record;
+  gsize len = strlen (name);
+  guint32 bucket;
+  guint32 slot;
+
+  if (index->header->n_entries == 0)
+    return FALSE;
+
+  bucket = index_hash (name, len, 0) % index->header->n_buckets;
+  slot = index_hash (name, len, index->buckets[bucket]) %
+         index->header->n_entries;
+
+  record = index_read_record (index, index->slots[slot], entry);
+
+  return record != NULL && record->key_len == len &&
+         KEYNCMP (entry->key, name, len) == 0;
+}
+
+gboolean
+pkg_index_is_exact (PkgIndex *index)
+{
+  return (index->header->flags & INDEX_FLAG_EXACT) != 0;
+}
+
+guint
+pkg_index_get_size (PkgIndex *index)
+{
+  return index->header->n_entries;
+}
+
+gboolean
+pkg_index_get_entry (PkgIndex *index, guint i, PkgIndexEntry *entry)
+{
+  if (i >= index->header->n_entries)
+    return FALSE;
+
+  return index_read_record (index, index->slots[i], entry) != NULL;
+}
+
+gboolean
+pkg_index_entry_fresh (const PkgIndexEntry *entry, const GStatBuf *st)
+{
+  return !entry->racy &&
+         entry->mtime == (guint64) st->st_mtime &&
+         entry->ctime == (guint64) st->st_ctime &&
+         entry->size == (guint64) st->st_size &&
+         entry->dev == (guint64) st->st_dev &&
+         entry->ino == (guint64) st->st_ino;
+}
+
+/* A package being indexed */
+typedef struct
+{
+  char *key;
+  GString *data;
+  GStatBuf st;
+  gboolean racy;
+  guint32 bucket;
+} BuildEntry;
+
+static void
+build_entry_free (gpointer data)
+{
+  BuildEntry *entry = data;
+
+  g_free (entry->key);
+  g_string_free (entry->data, TRUE);
+  g_free (entry);
+}
+
+/* Collect the regular *.pc files of DIRNAME, taking the entries of the
+ * files that did not change from OLD.
+ */
+static GPtrArray *
+list_entries (const char *dirname, PkgIndex *old, GError **error)
+{
+  GPtrArray *entries;
+  GDir *dir;
+  const gchar *filename;
+
+  dir = g_dir_open (dirname, 0, error);
+  if (dir == NULL)
+    return NULL;
+
+  entries = g_ptr_array_new_with_free_func (build_entry_free);
+
+  while ((filename = g_dir_read_name (dir)))
+    {
+      gsize len = strlen (filename);
+      PkgIndexEntry old_entry;
+      BuildEntry *entry;
+      GStatBuf st;
+      char *path;
+
+      if (len <= EXT_LEN ||
+#ifdef G_OS_WIN32
+          g_ascii_strcasecmp (filename + len - EXT_LEN, ".pc") != 0
+#else
+          strcmp (filename + len - EXT_LEN, ".pc") != 0
+#endif
+          )
+        continue;
+
+      path = g_build_filename (dirname, filename, NULL);
+      if (g_stat (path, &st) != 0 || !S_ISREG (st.st_mode))
+        {
+          g_free (path);
+          continue;
+        }
+
+      entry = g_new0 (BuildEntry, 1);
+      entry->key = g_strndup (filename, len - EXT_LEN);
+      entry->data = g_string_new (NULL);
+      entry->st = st;
+
+      if (old != NULL && pkg_index_lookup (old, entry->key, &old_entry) &&
+          pkg_index_entry_fresh (&old_entry, &st))
+        {
+          debug_spew ("Keeping index entry of '%s'\n", path);
+          g_string_append_len (entry->data, old_entry.data,
+                               old_entry.length);
+        }
+      else
+        {
+          char *contents;
+          gsize length;
+
+          debug_spew ("Indexing '%s'\n", path);
+          if (!g_file_get_contents (path, &contents, &length, error))
+            {
+              build_entry_free (entry);
+              g_free (path);
+              g_ptr_array_free (entries, TRUE);
+              g_dir_close (dir);
+              return NULL;
+            }
+          strip_unparsed_lines (contents, length, PKG_INDEX_FIELDS,
+                                entry->data);
+          g_free (contents);
+        }
+
+      /* A file changed less than RACY_MTIME_SECONDS ago, or while it was
+       * read, may change again without its status moving, so its lines
+       * are always read back from the file itself.
+       */
+      entry->racy = time (NULL) - st.st_mtime < RACY_MTIME_SECONDS;
+
+      g_free (path);
+      g_ptr_array_add (entries, entry);
+    }
+  g_dir_close (dir);
+
+  return entries;
+}
+
+typedef struct
+{
+  guint32 bucket;
+  guint32 size;
+} BucketSize;
+
+static int
+bucket_size_cmp (const void *a, const void *b)
+{
+  const BucketSize *ba = a;
+  const BucketSize *bb = b;
+
+  if (ba->size != bb->size)
+    return ba->size > bb->size ? -1 : 1;
+
+  return ba->bucket < bb->bucket ? -1 : ba->bucket > bb->bucket;
+}
+
+/* Find a displacement for each of the N_BUCKETS buckets that sends the
+ * keys of ENTRIES to distinct slots, placing the biggest buckets first.
+ * SLOTS receives the number of the entry in each slot.
+ */
+static gboolean
+assign_slots (GPtrArray *entries, guint32 n_buckets, guint32 *buckets,
+              guint32 *slots)
+{
+  guint32 n = entries->len;
+  BucketSize *sizes = g_new0 (BucketSize, n_buckets);
+  GPtrArray **members = g_new0 (GPtrArray *, n_buckets);
+  gboolean *taken = g_new0 (gboolean, n);
+  guint32 *chosen = g_new (guint32, n);
+  gboolean ok = TRUE;
+  guint32 i;
+
+  for (i = 0; i < n_buckets; i++)
+    {
+      sizes[i].bucket = i;
+      members[i] = g_ptr_array_new ();
+      buckets[i] = 0;
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      BuildEntry *entry = g_ptr_array_index (entries, i);
+
+      entry->bucket = index_hash (entry->key, strlen (entry->key), 0) %
+                      n_buckets;
+      sizes[entry->bucket].size++;
+      g_ptr_array_add (members[entry->bucket], GUINT_TO_POINTER (i));
+    }
+
+  qsort (sizes, n_buckets, sizeof (BucketSize), bucket_size_cmp);
+
+  for (i = 0; i < n_buckets && sizes[i].size > 0 && ok; i++)
+    {
+      GPtrArray *bucket = members[sizes[i].bucket];
+      guint32 d;
+      guint32 j;
+
+      for (d = 1; d <= MAX_DISPLACEMENT; d++)
+        {
+          for (j = 0; j < bucket->len; j++)
+            {
+              BuildEntry *entry =
+                g_ptr_array_index (entries,
+                                   GPOINTER_TO_UINT (bucket->pdata[j]));
+              guint32 k;
+
+              chosen[j] = index_hash (entry->key, strlen (entry->key), d) % n;
+              if (taken[chosen[j]])
+                break;
+              for (k = 0; k < j && chosen[k] != chosen[j]; k++)
+                ;
+              if (k < j)
+                break;
+            }
+
+          if (j == bucket->len)
+            break;
+        }
+
+      if (d > MAX_DISPLACEMENT)
+        {
+          ok = FALSE;
+          break;
+        }
+
+      buckets[sizes[i].bucket] = d;
+      for (j = 0; j < bucket->len; j++)
+        {
+          taken[chosen[j]] = TRUE;
+          slots[chosen[j]] = GPOINTER_TO_UINT (bucket->pdata[j]);
+        }
+    }
+
+  g_free (chosen);
+  g_free (taken);
+  for (i = 0; i < n_buckets; i++)
+    g_ptr_array_free (members[i], TRUE);
+  g_free (members);
+  g_free (sizes);
+
+  return ok;
+}
+
+static void
+pad8 (GString *out)
+{
+  while (out->len % 8 != 0)
+    g_string_append_c (out, '\0');
+}
+
+/* Lay out the index of ENTRIES, listed from DIRNAME with status ST,
+ * returning NULL if no perfect hash was found or the index would be
+ * too big to address.
+ */
+static GString *
+serialize_index (const char *dirname, GPtrArray *entries,
+                 const GStatBuf *st)
+{
+  IndexHeader header;
+  GString *out;
+  guint32 n = entries->len;
+  guint32 n_buckets = n / 2 + 1;
+  guint32 *buckets;
+  guint32 *slots;
+  guint32 *offsets;
+  gsize slots_offset;
+  const char *sample = NULL;
+  guint32 i;
+
+  buckets = g_new0 (guint32, n + 1);
+  slots = g_new0 (guint32, n);
+  while (!assign_slots (entries, n_buckets, buckets, slots))
+    {
+      if (n_buckets == n + 1)
+        {
+          g_free (slots);
+          g_free (buckets);
+          return NULL;
+        }
+
+      /* Smaller buckets are easier to place */
+      n_buckets = MIN (n_buckets * 2, n + 1);
+      debug_spew ("Retrying the package index with %u buckets\n", n_buckets);
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, index_magic, sizeof (index_magic));
+  header.byte_order = INDEX_BYTE_ORDER;
+  header.n_entries = n;
+  header.n_buckets = n_buckets;
+  header.dir_mtime = st->st_mtime;
+  header.dir_dev = st->st_dev;
+  header.dir_ino = st->st_ino;
+
+  for (i = 0; i < n && sample == NULL; i++)
+    {
+      BuildEntry *entry = g_ptr_array_index (entries, i);
+      const char *p;
+
+      for (p = entry->key; *p != '\0' && !g_ascii_isalpha (*p); p++)
+        ;
+      if (*p != '\0')
+        sample = entry->key;
+    }
+  if (dir_names_exact (dirname, sample))
+    header.flags |= INDEX_FLAG_EXACT;
+
+  out = g_string_new (NULL);
+  g_string_append_len (out, (const char *) &header, sizeof (header));
+  g_string_append_len (out, (const char *) buckets, 4 * n_buckets);
+  slots_offset = out->len;
+  g_string_set_size (out, out->len + 4 * n);
+  pad8 (out);
+
+  offsets = g_new (guint32, n);
+  for (i = 0; i < n; i++)
+    {
+      BuildEntry *entry = g_ptr_array_index (entries, i);
+      IndexRecord record;
+
+      if (out->len > G_MAXUINT32)
+        break;
+      offsets[i] = out->len;
+
+      memset (&record, 0, sizeof (record));
+      record.mtime = entry->st.st_mtime;
+      record.ctime = entry->st.st_ctime;
+      record.size = entry->st.st_size;
+      record.dev = entry->st.st_dev;
+      record.ino = entry->st.st_ino;
+      record.racy = entry->racy;
+      record.key_len = strlen (entry->key);
+      record.data_len = entry->data->len;
+      g_string_append_len (out, (const char *) &record, sizeof (record));
+      g_string_append_len (out, entry->key, record.key_len + 1);
+      g_string_append_len (out, entry->data->str, entry->data->len + 1);
+      pad8 (out);
+    }
+
+  if (i == n)
+    for (i = 0; i < n; i++)
+      memcpy (out->str + slots_offset + 4 * i, &offsets[slots[i]], 4);
+  else
+    {
+      g_string_free (out, TRUE);
+      out = NULL;
+    }
+
+  g_free (offsets);
+  g_free (slots);
+  g_free (buckets);
+
+  return out;
+}
+
+static gboolean
+same_dir_status (const GStatBuf *a, const GStatBuf *b)
+{
+  return a->st_mtime == b->st_mtime && a->st_dev == b->st_dev &&
+         a->st_ino == b->st_ino;
+}
+
+gboolean
+pkg_index_build (const char *dirname, GError **error)
+{
+  GPtrArray *entries = NULL;
+  PkgIndex *old;
+  GString *out;
+  GStatBuf st;
+  GStatBuf after;
+  char *path;
+  gboolean ok;
+
+  path = index_path (dirname);
+  if (path == NULL)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   "No place to put the index of '%s'", dirname);
+      return FALSE;
+    }
+
+  old = index_open (path);
+
+  /* The index is only used while the directory keeps the mtime it had
+   * when it was listed, so wait until a change could not keep it.
+   */
+  while (entries == NULL)
+    {
+      time_t age;
+
+      if (g_stat (dirname, &st) != 0)
+        {
+          int saved_errno = errno;
+
+          g_set_error (error, G_FILE_ERROR,
+                       g_file_error_from_errno (saved_errno),
+                       "Cannot stat '%s': %s", dirname,
+                       g_strerror (saved_errno));
+          break;
+        }
+
+      age = time (NULL) - st.st_mtime;
+      if (age >= 0 && age < RACY_MTIME_SECONDS)
+        {
+          debug_spew ("Waiting for directory '%s' to settle\n", dirname);
+          g_usleep ((RACY_MTIME_SECONDS - age) * G_USEC_PER_SEC);
+          continue;
+        }
+
+      entries = list_entries (dirname, old, error);
+      if (entries == NULL)
+        break;
+
+      if (g_stat (dirname, &after) != 0 || !same_dir_status (&st, &after))
+        {
+          debug_spew ("Directory '%s' changed while indexing it\n", dirname);
+          g_ptr_array_free (entries, TRUE);
+          entries = NULL;
+        }
+    }
+
+  if (old != NULL)
+    pkg_index_free (old);
+
+  if (entries == NULL)
+    {
+      g_free (path);
+      return FALSE;
+    }
+
+  out = serialize_index (dirname, entries, &st);
+  if (out == NULL)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   "Cannot index the packages in '%s'", dirname);
+      ok = FALSE;
+    }
+  else
+    {
+      debug_spew ("Writing package index '%s' with %u packages\n",
+                  path, entries->len);
+      ok = g_file_set_contents (path, out->str, out->len, error);
+      g_string_free (out, TRUE);
+    }
+
+  g_ptr_array_free (entries, TRUE);
+  g_free (path);
+
+  return ok;
+}
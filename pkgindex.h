@@ -0,0 +1,90 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef PKG_CONFIG_PKGINDEX_H
+#define PKG_CONFIG_PKGINDEX_H
+
+#include "pkg.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+/* The fields an index can answer queries about. The other fields have
+ * to be parsed from the .pc files themselves.
+ */
+#define PKG_INDEX_FIELDS (FIELD_REQUIRES | FIELD_REQUIRES_PRIVATE | \
+                          FIELD_CONFLICTS)
+
+typedef struct PkgIndex_ PkgIndex;
+
+/* A package of an index. DATA holds the lines of its .pc file that are
+ * parsed with PKG_INDEX_FIELDS.
+ */
+typedef struct
+{
+  const char *key;
+  const char *data;
+  gsize length;
+  guint64 mtime;
+  guint64 ctime;
+  guint64 size;
+  guint64 dev;
+  guint64 ino;
+  gboolean racy;
+} PkgIndexEntry;
+
+/* Map the index written by pkg_index_build() for DIRNAME. Returns NULL
+ * if there is none or the directory changed since it was written.
+ */
+PkgIndex * pkg_index_load        (const char    *dirname);
+
+void       pkg_index_free        (PkgIndex      *index);
+
+/* Look up the package NAME, returning FALSE if the directory has no
+ * NAME.pc.
+ */
+gboolean   pkg_index_lookup      (PkgIndex      *index,
+                                  const char    *name,
+                                  PkgIndexEntry *entry);
+
+/* Whether a name that pkg_index_lookup() does not find surely has no
+ * .pc file in the directory.
+ */
+gboolean   pkg_index_is_exact    (PkgIndex      *index);
+
+/* Number of packages in the index, which can be read with
+ * pkg_index_get_entry().
+ */
+guint      pkg_index_get_size    (PkgIndex      *index);
+
+gboolean   pkg_index_get_entry   (PkgIndex      *index,
+                                  guint          i,
+                                  PkgIndexEntry *entry);
+
+/* Whether the .pc file of ENTRY, whose status is ST, is surely
+ * unchanged since it was indexed.
+ */
+gboolean   pkg_index_entry_fresh (const PkgIndexEntry *entry,
+                                  const GStatBuf      *st);
+
+/* Write the index of the .pc files in DIRNAME, reusing the entries of
+ * the previous index for files that did not change.
+ */
+gboolean   pkg_index_build       (const char    *dirname,
+                                  GError       **error);
+
+#endif